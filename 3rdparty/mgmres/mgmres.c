@@ -292,6 +292,58 @@ ax_cr (int n, int nz_num, int ia[], int ja[], double a[], double x[],
 
 /******************************************************************************/
 
+void
+ax_cr_omp (int n, int nz_num, int ia[], int ja[], double a[], double x[],
+           double w[], int nt)
+/******************************************************************************/
+/*
+ * Purpose:
+ * 
+ * AX_CR_OMP computes A*x for a matrix stored in sparse compressed row form,
+ * using NT threads.
+ * 
+ * Discussion:
+ * 
+ * This is AX_CR with the rows distributed over the threads.  The rows
+ * may differ much in length, so they are handed out in chunks.
+ * 
+ * Parameters:
+ * 
+ * Input, int N, the order of the system.
+ * 
+ * Input, int NZ_NUM, the number of nonzeros.
+ * 
+ * Input, int IA[N+1], JA[NZ_NUM], the row and column indices
+ * of the matrix values.  The row vector has been compressed.
+ * 
+ * Input, double A[NZ_NUM], the matrix values.
+ * 
+ * Input, double X[N], the vector to be multiplied by A.
+ * 
+ * Output, double W[N], the value of A*X.
+ * 
+ * Input, int NT, the number of threads.
+ */
+{
+    int i;
+    int k;
+    double sum;
+
+#pragma omp parallel for private(k, sum) schedule(dynamic, 1024) num_threads(nt)
+    for (i = 0; i < n; i++)
+    {
+        sum = 0.0;
+        for (k = ia[i]; k < ia[i + 1]; k++)
+        {
+            sum = sum + a[k] * x[ja[k]];
+        }
+        w[i] = sum;
+    }
+    return;
+}
+
+/******************************************************************************/
+
 void
 ax_st (int n, int nz_num, int ia[], int ja[], double a[], double x[],
        double w[])
@@ -642,16 +694,16 @@ ilu_cr (int n, int nz_num, int ia[], int ja[], double a[], int ua[], double l[])
         l[k] = a[k];
     }
 
+    for (j = 0; j < n; j++)
+    {
+        iw[j] = -1;
+    }
+
     for (i = 0; i < n; i++)
     {
         /*
          * IW points to the nonzero entries in row I.
          */
-        for (j = 0; j < n; j++)
-        {
-            iw[j] = -1;
-        }
-
         for (k = ia[i]; k <= ia[i + 1] - 1; k++)
         {
             iw[ja[k]] = k;
@@ -701,6 +753,14 @@ ilu_cr (int n, int nz_num, int ia[], int ja[], double a[], int ua[], double l[])
         }
 
         l[j] = 1.0 / l[j];
+
+        /*
+         * Only the entries of row I are reset, not all of IW.
+         */
+        for (k = ia[i]; k <= ia[i + 1] - 1; k++)
+        {
+            iw[ja[k]] = -1;
+        }
     }
 
     for (k = 0; k < n; k++)
@@ -715,6 +775,245 @@ ilu_cr (int n, int nz_num, int ia[], int ja[], double a[], int ua[], double l[])
 
 /******************************************************************************/
 
+void
+ilu_cr_omp (int n, int nz_num, int ia[], int ja[], double a[], int ua[],
+            double l[], int nlev, int lstart[], int lrow[], int nt)
+/******************************************************************************/
+/*
+ * Purpose:
+ * 
+ * ILU_CR_OMP computes the incomplete LU factorization of a matrix, using
+ * NT threads.
+ * 
+ * Discussion:
+ * 
+ * This is ILU_CR with the rows factored level by level.  Row I only
+ * depends on the rows of its strictly lower part, which are in earlier
+ * levels of the lower triangle, see LEVEL_SETS_CR.  The rows of one
+ * level are factored in parallel, each thread with its own work vector
+ * of length N.  The result is the same as that of ILU_CR.
+ * 
+ * Parameters:
+ * 
+ * Input, int N, the order of the system.
+ * 
+ * Input, int NZ_NUM, the number of nonzeros.
+ * 
+ * Input, int IA[N+1], JA[NZ_NUM], the row and column indices
+ * of the matrix values.  The row vector has been compressed.
+ * 
+ * Input, double A[NZ_NUM], the matrix values.
+ * 
+ * Input, int UA[N], the index of the diagonal element of each row.
+ * 
+ * Output, double L[NZ_NUM], the ILU factorization of A.
+ * 
+ * Input, int NLEV, LSTART[NLEV+1], LROW[N], the level sets of the lower
+ * triangle of A.
+ * 
+ * Input, int NT, the number of threads.
+ */
+{
+    int i;
+    int *iw;
+    int j;
+    int jj;
+    int jrow;
+    int jw;
+    int k;
+    int lev;
+    int p;
+    double tl;
+
+#pragma omp parallel private(i, iw, j, jj, jrow, jw, k, lev, p, tl) \
+    num_threads(nt)
+    {
+#pragma omp for schedule(static)
+        for (k = 0; k < nz_num; k++)
+        {
+            l[k] = a[k];
+        }
+
+        iw = (int *) malloc (n * sizeof (int));
+        for (j = 0; j < n; j++)
+        {
+            iw[j] = -1;
+        }
+
+        for (lev = 0; lev < nlev; lev++)
+        {
+#pragma omp for schedule(dynamic, 64)
+            for (p = lstart[lev]; p < lstart[lev + 1]; p++)
+            {
+                i = lrow[p];
+                /*
+                 * IW points to the nonzero entries in row I.
+                 */
+                for (k = ia[i]; k < ia[i + 1]; k++)
+                {
+                    iw[ja[k]] = k;
+                }
+
+                for (j = ia[i]; j < ua[i]; j++)
+                {
+                    jrow = ja[j];
+                    tl = l[j] * l[ua[jrow]];
+                    l[j] = tl;
+                    for (jj = ua[jrow] + 1; jj < ia[jrow + 1]; jj++)
+                    {
+                        jw = iw[ja[jj]];
+                        if (jw != -1)
+                        {
+                            l[jw] = l[jw] - tl * l[jj];
+                        }
+                    }
+                }
+
+                if (l[ua[i]] == 0.0)
+                {
+                    printf ("\n");
+                    printf ("ILU_CR_OMP - Fatal error!\n");
+                    printf ("  Zero pivot on step I = \n");
+                    printf ("  L[%d] = 0.0\n", ua[i]);
+                    exit (1);
+                }
+
+                l[ua[i]] = 1.0 / l[ua[i]];
+
+                for (k = ia[i]; k < ia[i + 1]; k++)
+                {
+                    iw[ja[k]] = -1;
+                }
+            }
+        }
+
+        free (iw);
+
+#pragma omp for schedule(static)
+        for (k = 0; k < n; k++)
+        {
+            l[ua[k]] = 1.0 / l[ua[k]];
+        }
+    }
+
+    return;
+}
+
+/******************************************************************************/
+
+int
+level_sets_cr (int n, int ia[], int ja[], int ua[], int upper, int start[],
+               int row[])
+/******************************************************************************/
+/*
+ * Purpose:
+ * 
+ * LEVEL_SETS_CR groups the rows of a triangle of a matrix into levels.
+ * 
+ * Discussion:
+ * 
+ * A row of the lower triangle is in the level after the highest level
+ * of the rows its strictly lower part refers to, starting at level 0.
+ * The rows of one level do not depend on each other, so that the
+ * forward substitution, and the incomplete LU factorization, can treat
+ * them in parallel once the earlier levels are done.  The same holds
+ * for the strictly upper parts and the backward substitution.
+ * 
+ * The number of levels depends on the order of the rows.  It is small
+ * for a random order of sparse, local couplings, but close to N when
+ * neighbors are numbered consecutively.
+ * 
+ * Parameters:
+ * 
+ * Input, int N, the order of the system.
+ * 
+ * Input, int IA[N+1], JA[NZ_NUM], the row and column indices
+ * of the matrix values.  The row vector has been compressed.
+ * 
+ * Input, int UA[N], the index of the diagonal element of each row.
+ * 
+ * Input, int UPPER, whether the upper rather than the lower triangle is
+ * considered.
+ * 
+ * Output, int START[N+1], the rows of level LEV are ROW[START[LEV]]
+ * through ROW[START[LEV+1]-1].
+ * 
+ * Output, int ROW[N], the rows ordered by level, and by index within
+ * a level.
+ * 
+ * Output, int LEVEL_SETS_CR, the number of levels.
+ */
+{
+    int i;
+    int ii;
+    int k;
+    int *level;
+    int nlev;
+
+    level = (int *) malloc (n * sizeof (int));
+
+    nlev = 0;
+    for (ii = 0; ii < n; ii++)
+    {
+        i = upper ? n - 1 - ii : ii;
+        level[i] = 0;
+        if (upper)
+        {
+            for (k = ua[i] + 1; k < ia[i + 1]; k++)
+            {
+                if (level[i] < level[ja[k]] + 1)
+                {
+                    level[i] = level[ja[k]] + 1;
+                }
+            }
+        }
+        else
+        {
+            for (k = ia[i]; k < ua[i]; k++)
+            {
+                if (level[i] < level[ja[k]] + 1)
+                {
+                    level[i] = level[ja[k]] + 1;
+                }
+            }
+        }
+        if (nlev < level[i] + 1)
+        {
+            nlev = level[i] + 1;
+        }
+    }
+    /*
+     * Sort the rows by level.
+     */
+    for (k = 0; k <= nlev; k++)
+    {
+        start[k] = 0;
+    }
+    for (i = 0; i < n; i++)
+    {
+        start[level[i] + 1]++;
+    }
+    for (k = 0; k < nlev; k++)
+    {
+        start[k + 1] = start[k + 1] + start[k];
+    }
+    for (i = 0; i < n; i++)
+    {
+        row[start[level[i]]++] = i;
+    }
+    for (k = nlev; 0 < k; k--)
+    {
+        start[k] = start[k - 1];
+    }
+    start[0] = 0;
+
+    free (level);
+
+    return nlev;
+}
+
+/******************************************************************************/
+
 void
 lus_cr (int n, int nz_num, int ia[], int ja[], double l[], int ua[],
         double r[], double z[])
@@ -815,6 +1114,97 @@ lus_cr (int n, int nz_num, int ia[], int ja[], double l[], int ua[],
 
 /******************************************************************************/
 
+void
+lus_cr_omp (int n, int nz_num, int ia[], int ja[], double l[], int ua[],
+            double r[], double z[], int nlev, int lstart[], int lrow[],
+            int ulev, int ustart[], int urow[], int nt)
+/******************************************************************************/
+/*
+ * Purpose:
+ * 
+ * LUS_CR_OMP applies the incomplete LU preconditioner, using NT threads.
+ * 
+ * Discussion:
+ * 
+ * This is LUS_CR with the triangular solves done level by level, see
+ * LEVEL_SETS_CR, the rows of one level in parallel.  R and Z may be the
+ * same vector.
+ * 
+ * Parameters:
+ * 
+ * Input, int N, the order of the system.
+ * 
+ * Input, int NZ_NUM, the number of nonzeros.
+ * 
+ * Input, int IA[N+1], JA[NZ_NUM], the row and column indices
+ * of the matrix values.  The row vector has been compressed.
+ * 
+ * Input, double L[NZ_NUM], the matrix values, as factored by ILU_CR.
+ * 
+ * Input, int UA[N], the index of the diagonal element of each row.
+ * 
+ * Input, double R[N], the right hand side.
+ * 
+ * Output, double Z[N], the solution of the system M * Z = R.
+ * 
+ * Input, int NLEV, LSTART[NLEV+1], LROW[N], the level sets of the lower
+ * triangle.
+ * 
+ * Input, int ULEV, USTART[ULEV+1], UROW[N], the level sets of the upper
+ * triangle.
+ * 
+ * Input, int NT, the number of threads.
+ */
+{
+    int i;
+    int j;
+    int lev;
+    int p;
+    double w;
+
+#pragma omp parallel private(i, j, lev, p, w) num_threads(nt)
+    {
+        /*
+         * Solve L * z = r where L is unit lower triangular.
+         */
+        for (lev = 0; lev < nlev; lev++)
+        {
+#pragma omp for schedule(dynamic, 64)
+            for (p = lstart[lev]; p < lstart[lev + 1]; p++)
+            {
+                i = lrow[p];
+                w = r[i];
+                for (j = ia[i]; j < ua[i]; j++)
+                {
+                    w = w - l[j] * z[ja[j]];
+                }
+                z[i] = w;
+            }
+        }
+        /*
+         * Solve U * z = z, where U is upper triangular.
+         */
+        for (lev = 0; lev < ulev; lev++)
+        {
+#pragma omp for schedule(dynamic, 64)
+            for (p = ustart[lev]; p < ustart[lev + 1]; p++)
+            {
+                i = urow[p];
+                w = z[i];
+                for (j = ua[i] + 1; j < ia[i + 1]; j++)
+                {
+                    w = w - l[j] * z[ja[j]];
+                }
+                z[i] = w / l[ua[i]];
+            }
+        }
+    }
+
+    return;
+}
+
+/******************************************************************************/
+
 void
 mgmres_st (int n, int nz_num, int ia[], int ja[], double a[],
            double x[], double rhs[], int itr_max, int mr, double tol_abs,
@@ -1489,6 +1879,278 @@ pmgmres_ilu_cr (int n, int nz_num, int ia[], int ja[], double a[],
 
 /******************************************************************************/
 
+int
+pmgmres_ilu_cr_omp (int n, int nz_num, int ia[], int ja[], double a[],
+                    double x[], double rhs[], int itr_max, int mr,
+                    double tol_abs, double tol_rel, int nt)
+/******************************************************************************/
+/*
+ * Purpose:
+ * 
+ * PMGMRES_ILU_CR_OMP applies the preconditioned restarted GMRES
+ * algorithm, using NT threads.
+ * 
+ * Discussion:
+ * 
+ * This is PMGMRES_ILU_CR with the matrix-vector products, dot products
+ * and vector updates distributed over the threads.  The incomplete LU
+ * factorization and the triangular solves of the preconditioner are
+ * scheduled by level sets, see LEVEL_SETS_CR, so that the preconditioner,
+ * and with it the number of iterations, are those of PMGMRES_ILU_CR.
+ * How many threads the preconditioner keeps busy depends on the number
+ * of rows per level.
+ * 
+ * Parameters:
+ * 
+ * Input, int N, the order of the linear system.
+ * 
+ * Input, int NZ_NUM, the number of nonzero matrix values.
+ * 
+ * Input, int IA[N+1], JA[NZ_NUM], the row and column indices
+ * of the matrix values.  The row vector has been compressed.
+ * 
+ * Input, double A[NZ_NUM], the matrix values.
+ * 
+ * Input/output, double X[N]; on input, an approximation to
+ * the solution.  On output, an improved approximation.
+ * 
+ * Input, double RHS[N], the right hand side of the linear system.
+ * 
+ * Input, int ITR_MAX, the maximum number of (outer) iterations to take.
+ * 
+ * Input, int MR, the maximum number of (inner) iterations to take.
+ * MR must be less than N.
+ * 
+ * Input, double TOL_ABS, an absolute tolerance applied to the
+ * current residual.
+ * 
+ * Input, double TOL_REL, a relative tolerance comparing the
+ * current residual to the initial residual.
+ * 
+ * Input, int NT, the number of threads.
+ */
+{
+    double av;
+    double *c;
+    double delta = 1.0e-03;
+    double *g;
+    double **h;
+    double htmp;
+    double hkk;
+    int i;
+    int itr;
+    int itr_used;
+    int j;
+    int k;
+    int k_copy = 0;
+    double *l;
+    int *lrow;
+    int *lstart;
+    int nlev;
+    double mu;
+    double *r;
+    double rho;
+    double rho_tol = 0;
+    double *s;
+    int *ua;
+    int ulev;
+    int *urow;
+    int *ustart;
+    double **v;
+    double *y;
+
+    itr_used = 0;
+
+    c = (double *) malloc ((mr + 1) * sizeof (double));
+    g = (double *) malloc ((mr + 1) * sizeof (double));
+    h = dmatrix (0, mr, 0, mr - 1);
+    l = (double *) malloc ((ia[n] + 1) * sizeof (double));
+    r = (double *) malloc (n * sizeof (double));
+    s = (double *) malloc ((mr + 1) * sizeof (double));
+    ua = (int *) malloc (n * sizeof (int));
+    v = dmatrix (0, mr, 0, n - 1);
+    y = (double *) malloc ((mr + 1) * sizeof (double));
+    lrow = (int *) malloc (n * sizeof (int));
+    lstart = (int *) malloc ((n + 1) * sizeof (int));
+    urow = (int *) malloc (n * sizeof (int));
+    ustart = (int *) malloc ((n + 1) * sizeof (int));
+
+    rearrange_cr (n, nz_num, ia, ja, a);
+
+    diagonal_pointer_cr (n, nz_num, ia, ja, ua);
+
+    nlev = level_sets_cr (n, ia, ja, ua, 0, lstart, lrow);
+    ulev = level_sets_cr (n, ia, ja, ua, 1, ustart, urow);
+
+    ilu_cr_omp (n, nz_num, ia, ja, a, ua, l, nlev, lstart, lrow, nt);
+
+    for (itr = 0; itr < itr_max; itr++)
+    {
+        ax_cr_omp (n, nz_num, ia, ja, a, x, r, nt);
+
+#pragma omp parallel for schedule(static) num_threads(nt)
+        for (i = 0; i < n; i++)
+        {
+            r[i] = rhs[i] - r[i];
+        }
+
+        lus_cr_omp (n, nz_num, ia, ja, l, ua, r, r, nlev, lstart, lrow,
+                    ulev, ustart, urow, nt);
+
+        rho = sqrt (r8vec_dot_omp (n, r, r, nt));
+
+        if (itr == 0)
+        {
+            rho_tol = rho * tol_rel;
+        }
+
+#pragma omp parallel for schedule(static) num_threads(nt)
+        for (i = 0; i < n; i++)
+        {
+            v[0][i] = r[i] / rho;
+        }
+
+        g[0] = rho;
+        for (i = 1; i < mr + 1; i++)
+        {
+            g[i] = 0.0;
+        }
+
+        for (i = 0; i < mr + 1; i++)
+        {
+            for (j = 0; j < mr; j++)
+            {
+                h[i][j] = 0.0;
+            }
+        }
+
+        for (k = 0; k < mr; k++)
+        {
+            k_copy = k;
+
+            ax_cr_omp (n, nz_num, ia, ja, a, v[k], v[k + 1], nt);
+
+            lus_cr_omp (n, nz_num, ia, ja, l, ua, v[k + 1], v[k + 1], nlev,
+                        lstart, lrow, ulev, ustart, urow, nt);
+
+            av = sqrt (r8vec_dot_omp (n, v[k + 1], v[k + 1], nt));
+
+            for (j = 0; j <= k; j++)
+            {
+                h[j][k] = r8vec_dot_omp (n, v[k + 1], v[j], nt);
+                htmp = h[j][k];
+#pragma omp parallel for schedule(static) num_threads(nt)
+                for (i = 0; i < n; i++)
+                {
+                    v[k + 1][i] = v[k + 1][i] - htmp * v[j][i];
+                }
+            }
+            h[k + 1][k] = sqrt (r8vec_dot_omp (n, v[k + 1], v[k + 1], nt));
+
+            if ((av + delta * h[k + 1][k]) == av)
+            {
+                for (j = 0; j < k + 1; j++)
+                {
+                    htmp = r8vec_dot_omp (n, v[k + 1], v[j], nt);
+                    h[j][k] = h[j][k] + htmp;
+#pragma omp parallel for schedule(static) num_threads(nt)
+                    for (i = 0; i < n; i++)
+                    {
+                        v[k + 1][i] = v[k + 1][i] - htmp * v[j][i];
+                    }
+                }
+                h[k + 1][k] = sqrt (r8vec_dot_omp (n, v[k + 1], v[k + 1], nt));
+            }
+
+            if (h[k + 1][k] != 0.0)
+            {
+                hkk = h[k + 1][k];
+#pragma omp parallel for schedule(static) num_threads(nt)
+                for (i = 0; i < n; i++)
+                {
+                    v[k + 1][i] = v[k + 1][i] / hkk;
+                }
+            }
+
+            if (0 < k)
+            {
+                for (i = 0; i < k + 2; i++)
+                {
+                    y[i] = h[i][k];
+                }
+                for (j = 0; j < k; j++)
+                {
+                    mult_givens (c[j], s[j], j, y);
+                }
+                for (i = 0; i < k + 2; i++)
+                {
+                    h[i][k] = y[i];
+                }
+            }
+            mu = sqrt (h[k][k] * h[k][k] + h[k + 1][k] * h[k + 1][k]);
+
+            c[k] = h[k][k] / mu;
+            s[k] = -h[k + 1][k] / mu;
+            h[k][k] = c[k] * h[k][k] - s[k] * h[k + 1][k];
+            h[k + 1][k] = 0.0;
+            mult_givens (c[k], s[k], k, g);
+
+            rho = fabs (g[k + 1]);
+
+            itr_used = itr_used + 1;
+
+            if (rho <= rho_tol && rho <= tol_abs)
+            {
+                break;
+            }
+        }
+
+        k = k_copy;
+
+        y[k] = g[k] / h[k][k];
+        for (i = k - 1; 0 <= i; i--)
+        {
+            y[i] = g[i];
+            for (j = i + 1; j < k + 1; j++)
+            {
+                y[i] = y[i] - h[i][j] * y[j];
+            }
+            y[i] = y[i] / h[i][i];
+        }
+#pragma omp parallel for private(j) schedule(static) num_threads(nt)
+        for (i = 0; i < n; i++)
+        {
+            for (j = 0; j < k + 1; j++)
+            {
+                x[i] = x[i] + v[j][i] * y[j];
+            }
+        }
+
+        if (rho <= rho_tol && rho <= tol_abs)
+        {
+            break;
+        }
+    }
+
+    free (c);
+    free (g);
+    free_dmatrix (h, 0, mr, 0, mr - 1);
+    free (l);
+    free (r);
+    free (s);
+    free (ua);
+    free_dmatrix (v, 0, mr, 0, n - 1);
+    free (y);
+    free (lrow);
+    free (lstart);
+    free (urow);
+    free (ustart);
+
+    return itr_used;
+}
+
+/******************************************************************************/
+
 double
 r8vec_dot (int n, double a1[], double a2[])
 /******************************************************************************/
@@ -1531,6 +2193,40 @@ r8vec_dot (int n, double a1[], double a2[])
 
 /******************************************************************************/
 
+double
+r8vec_dot_omp (int n, double a1[], double a2[], int nt)
+/******************************************************************************/
+/*
+ * Purpose:
+ * 
+ * R8VEC_DOT_OMP computes the dot product of a pair of R8VEC's, using NT
+ * threads.
+ * 
+ * Parameters:
+ * 
+ * Input, int N, the number of entries in the vectors.
+ * 
+ * Input, double A1[N], A2[N], the two vectors to be considered.
+ * 
+ * Input, int NT, the number of threads.
+ * 
+ * Output, double R8VEC_DOT_OMP, the dot product of the vectors.
+ */
+{
+    int i;
+    double value;
+
+    value = 0.0;
+#pragma omp parallel for reduction(+:value) schedule(static) num_threads(nt)
+    for (i = 0; i < n; i++)
+    {
+        value = value + a1[i] * a2[i];
+    }
+    return value;
+}
+
+/******************************************************************************/
+
 double *
 r8vec_uniform_01 (int n, int *seed)
 /******************************************************************************/
@@ -1684,6 +2380,7 @@ rearrange_cr (int n, int nz_num, int ia[], int ja[], double a[])
     int j1;
     int j2;
     int k;
+    int sorted;
 
     for (i = 0; i < n; i++)
     {
@@ -1691,12 +2388,15 @@ rearrange_cr (int n, int nz_num, int ia[], int ja[], double a[])
         j2 = ia[i + 1];
         is = j2 - j1;
 
-        for (k = 1; k < is; k++)
+        /* Rows that are already sorted need a single sweep only. */
+        for (k = 1, sorted = 0; k < is && !sorted; k++)
         {
+            sorted = 1;
             for (j = j1; j < j2 - k; j++)
             {
                 if (ja[j + 1] < ja[j])
                 {
+                    sorted = 0;
                     itemp = ja[j + 1];
                     ja[j + 1] = ja[j];
                     ja[j] = itemp;
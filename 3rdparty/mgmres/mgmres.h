@@ -4,6 +4,8 @@ void atx_st (int n, int nz_num, int ia[], int ja[], double a[], double x[],
              double w[]);
 void ax_cr (int n, int nz_num, int ia[], int ja[], double a[], double x[],
             double w[]);
+void ax_cr_omp (int n, int nz_num, int ia[], int ja[], double a[],
+                double x[], double w[], int nt);
 void ax_st (int n, int nz_num, int ia[], int ja[], double a[], double x[],
             double w[]);
 void diagonal_pointer_cr (int n, int nz_num, int ia[], int ja[], int ua[]);
@@ -13,8 +15,15 @@ void free_dmatrix (double **m, int nrl, int nrh, int ncl, int nch);
 void free_dvector (double *v, int nl, int nh);
 void ilu (int n, int nz_num, int ia[], int ja[], double a[], int ua[],
           double l[]);
+void ilu_cr_omp (int n, int nz_num, int ia[], int ja[], double a[], int ua[],
+                 double l[], int nlev, int lstart[], int lrow[], int nt);
+int level_sets_cr (int n, int ia[], int ja[], int ua[], int upper,
+                   int start[], int row[]);
 void lus (int n, int nz_num, int ia[], int ja[], double l[], int ua[],
           double r[], double z[]);
+void lus_cr_omp (int n, int nz_num, int ia[], int ja[], double l[], int ua[],
+                 double r[], double z[], int nlev, int lstart[], int lrow[],
+                 int ulev, int ustart[], int urow[], int nt);
 void mgmres_st (int n, int nz_num, int ia[], int ja[], double a[],
                 double x[], double rhs[], int itr_max, int mr, double tol_abs,
                 double tol_rel);
@@ -22,7 +31,11 @@ void mult_givens (double c, double s, int k, double *g);
 int pmgmres_ilu_cr (int n, int nz_num, int ia[], int ja[], double a[],
                      double x[], double rhs[], int itr_max, int mr,
                      double tol_abs, double tol_rel);
+int pmgmres_ilu_cr_omp (int n, int nz_num, int ia[], int ja[], double a[],
+                        double x[], double rhs[], int itr_max, int mr,
+                        double tol_abs, double tol_rel, int nt);
 double r8vec_dot (int n, double a1[], double a2[]);
+double r8vec_dot_omp (int n, double a1[], double a2[], int nt);
 double *r8vec_uniform_01 (int n, int *seed);
 void rearrange_cr (int n, int nz_num, int ia[], int ja[], double a[]);
 void timestamp (void);
@@ -26,6 +26,8 @@ typedef struct a_params
 {
     double dosnormalization;
     double fermienergy;
+    double temperature;
+    Params *prms;
 } a_params;
 
 double DOSunnormalized (double x, void *p);
@@ -35,17 +37,21 @@ double dosfermi (double x, void *p);
 
 
 double
-calcFermiEnergy ()
+calcFermiEnergy (RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     gsl_integration_workspace *w = gsl_integration_workspace_alloc (1000000);
     a_params params;
+    params.temperature = runprms->temperature;
+    params.prms = prms;
 
     // find the norm of the DOS
     double error;
     gsl_function F;
     F.function = &DOSunnormalized;
+    F.params = &params;
 
-    if (!prms.gaussian)
+    if (!prms->gaussian)
         gsl_integration_qagiu (&F, 0, 0, 1e-7, 1000000, w,
                                &(params.dosnormalization), &error);
     else
@@ -61,11 +67,11 @@ calcFermiEnergy ()
     while (upper - lower > precision)
     {
         params.fermienergy = (upper + lower) / 2.0;
-        if (!prms.gaussian)
+        if (!prms->gaussian)
             gsl_integration_qagiu (&F, 0, 0, 1e-7, 1000000, w, &result, &error);
         else
             gsl_integration_qagi (&F, 0, 1e-7, 1000000, w, &result, &error);
-        if (result < prms.ncarriers * 1.0 / prms.nsites)
+        if (result < runprms->ncarriers * 1.0 / prms->nsites)
             upper = params.fermienergy;
         else
             lower = params.fermienergy;
@@ -78,8 +84,8 @@ calcFermiEnergy ()
 double
 DOSunnormalized (double x, void *p)
 {
-    (void)(p);
-    return exp (-pow (x, prms.exponent));
+    struct a_params *params = (struct a_params *) p;
+    return exp (-pow (x, params->prms->exponent));
 }
 
 double
@@ -91,7 +97,7 @@ DOS (double x, a_params * params)
 double
 fermidirac (double x, a_params * params)
 {
-    return 1 / (1 + exp ((params->fermienergy - x) / prms.temperature));
+    return 1 / (1 + exp ((params->fermienergy - x) / params->temperature));
 }
 
 double
@@ -26,46 +26,70 @@
 #ifdef WITH_LIS
 
 #include "lis.h"
-int solve_lis(Site * sites, RunParams * runprms, int nnz, double * x);
+int solve_lis(RunParams * runprms, int nnz, int * ia, int * ja, double * a,
+              double * x);
 
 #endif /* WITH_LIS */
 
 void BE_solve (Site * sites, Results * res, RunParams * runprms);
-int solve_mgmres(Site * sites, RunParams * runprms, int nnz, double * x);
+int BE_assemble (Site * sites, RunParams * runprms, int **ia, int **ja,
+                 double **a);
+int solve_mgmres(RunParams * runprms, int nnz, int * ia, int * ja, double * a,
+                 double * x);
 
 void
 BE_run (Results * res, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     Site *sites = NULL;
+    int p;
 
     // some output
-    output (O_PARALLEL, "Starting %d. Iteration (total %d): Thread ID %d\n",
-            runprms->iRun, prms.number_runs, omp_get_thread_num ());
-    output (O_SERIAL, "\nRunning %d. iteration (total %d)\n", runprms->iRun,
-            prms.number_runs);
-
-    // create the sites, cells, carriers, hopping rates
+    output (prms, O_PARALLEL,
+            "Starting %d. Iteration (total %d): Thread ID %d\n",
+            runprms->iRun, prms->number_runs, omp_get_thread_num ());
+    output (prms, O_SERIAL,
+            "\nRunning %d. iteration (total %d)\n", runprms->iRun,
+            prms->number_runs);
+
+    // create the sites, the neighbors are searched only for the first
+    // point of the sweep
     sites = MC_createSites (runprms);
-    MC_createHoppingRates (sites, runprms);
-    if (prms.removesoftpairs)
-        MC_removeSoftPairs (sites, runprms);
+    for (p = 0; p < prms->npoints; ++p)
+    {
+        if (prms->npoints > 1)
+            output (prms, O_SERIAL,
+                    "\tPoint %d of %d: \t\tT = %2.4f, F = %2.4f\n",
+                    p + 1, prms->npoints, prms->temperatures[p],
+                    prms->fields[p]);
 
-    // solve
-    BE_solve (sites, res, runprms);
+        MC_setPoint (sites, runprms, p);
 
-    // write output files
-    if (strArgGiven (prms.output_folder))
-    {
-        writeResults (res, runprms);
-        writeConfig (runprms);
-        writeSites (sites, runprms);
+        // solve
+        BE_solve (sites, &res[p], runprms);
+
+        // write output files
+        if (strArgGiven (prms->output_folder))
+        {
+            writeResults (&res[p], runprms);
+            writeConfig (runprms);
+            writeSites (sites, runprms);
+        }
     }
 
     // free resources
-    int i;
-    for (i = 0; i < runprms->nSites; ++i)
-        free (sites[i].neighbors);
+    free (runprms->edgeOffset);
+    free (runprms->edges);
+    free (runprms->reverse);
+    runprms->edgeOffset = NULL;
+    runprms->edges = NULL;
+    runprms->reverse = NULL;
+    runprms->sites = NULL;
     free (sites);
+    free (runprms->siteOrder);
+    runprms->siteOrder = NULL;
+    free (runprms->positions);
+    runprms->positions = NULL;
 
     return;
 }
@@ -74,45 +98,51 @@ BE_run (Results * res, RunParams * runprms)
 void
 BE_solve (Site * sites, Results * res, RunParams * runprms)
 {
-    output (O_SERIAL, "\tSolving balance equations ...");
+    Params *prms = runprms->prms;
+    output (prms, O_SERIAL, "\tSolving balance equations ...");
     fflush (stdout);
 
     // measure the cpu time
     struct timeval start, end, result;
     gettimeofday (&start, NULL);
 
-    int i, nnz, j, it;
-    
-    // find out the number of entries
-    nnz = 2 * runprms->nSites - 1;
-    for (i = 1; i < runprms->nSites; ++i)
-        nnz += sites[i].nNeighbors;
+    int i, nnz, j, it, *ia, *ja;
+    double *a;
+
+    // the matrix is assembled once for either solver
+    nnz = BE_assemble (sites, runprms, &ia, &ja, &a);
 
     double *x = malloc (sizeof (double) * runprms->nSites);
 
-    if(prms.mgmres)
+    if(prms->mgmres)
     {
-        it = solve_mgmres(sites, runprms, nnz, x);
+        it = solve_mgmres(runprms, nnz, ia, ja, a, x);
     }
 
 #ifdef WITH_LIS
 
     else
     {
-        it = solve_lis(sites, runprms, nnz, x);
+        it = solve_lis(runprms, nnz, ia, ja, a, x);
     }
 
 #endif /* WITH_LIS */
 
+    free (a);
+    free (ia);
+    free (ja);
+
     //timer
     gettimeofday (&end, NULL);
     timeval_subtract (&result, &start, &end);
     double elapsed = result.tv_sec + (double) result.tv_usec / 1e6;
 
     // output
-    output (O_SERIAL, "\tDone! %f s duration, %d gmres iterations\n", elapsed, it);
-    output (O_PARALLEL, "Finished %d. Iteration (total %d): %fs duration, %d gmres iterations\n",
-            runprms->iRun, prms.number_runs, elapsed, it);
+    output (prms, O_SERIAL,
+            "\tDone! %f s duration, %d gmres iterations\n", elapsed, it);
+    output (prms, O_PARALLEL,
+            "Finished %d. Iteration (total %d): %fs duration, %d gmres iterations\n",
+            runprms->iRun, prms->number_runs, elapsed, it);
 
     // calculate mobility
     double sum = 0;
@@ -120,69 +150,100 @@ BE_solve (Site * sites, Results * res, RunParams * runprms)
         for (j = 0; j < sites[i].nNeighbors; ++j)
             sum +=
                 x[i] * sites[i].neighbors[j].rate *
-                (sites[i].neighbors[j].dist.z);
+                SLE_dist (&sites[i].neighbors[j], runprms).z;
 
-    res->mobility.values[runprms->iRun - 1] = sum / prms.field;
+    res->mobility.values[runprms->iRun - 1] = sum / runprms->field;
     res->mobility.done[runprms->iRun - 1] = true;
 
     res->nSites.values[runprms->iRun - 1] = (float)runprms->nSites;
     res->nSites.done[runprms->iRun - 1] = true;
 
+    res->discardedRate.values[runprms->iRun - 1] = runprms->discardedRate;
+    res->discardedRate.done[runprms->iRun - 1] = true;
+
 
     // free
     free (x);
 
 }
 
-#ifdef WITH_LIS
-
+/*
+ * Assembles the balance equations in compressed row storage. Row 0 is
+ * the normalization of the occupation probabilities, row i > 0 the
+ * balance of site i: the total rate out of i on the diagonal and the
+ * rates into i, which are those of the reverse edges. The reverse edge
+ * array thus serves as the transposed neighbor graph, the row lengths
+ * are known beforehand and the rows are filled independently, sorted by
+ * column. Returns the number of entries.
+ */
 int
-solve_lis(Site * sites, RunParams * runprms, int nnz, double * x)
+BE_assemble (Site * sites, RunParams * runprms, int **ia, int **ja,
+             double **a)
 {
-    int i, *ia, *ja, k, it;
-    double *a, *rhs;
-    SLE *neighbor;
-
-    //allocate memory
-    ia = malloc (sizeof (int) * nnz);
-    ja = malloc (sizeof (int) * nnz);
-    a = malloc (sizeof (double) * nnz);
-    rhs = calloc (runprms->nSites, sizeof (double));
-    
-    // create the arrays
-    int counter = 0;
+    int i, n = runprms->nSites, nnz;
 
-    for (i = 0; i < runprms->nSites; ++i)
+    // the row pointers give the exact number of entries
+    *ia = malloc (sizeof (int) * (n + 1));
+    (*ia)[0] = 0;
+    (*ia)[1] = n;
+    for (i = 1; i < n; ++i)
+        (*ia)[i + 1] = (*ia)[i] + 1 + sites[i].nNeighbors;
+    nnz = (*ia)[n];
+
+    *ja = malloc (sizeof (int) * nnz);
+    *a = malloc (sizeof (double) * nnz);
+
+    // the first row is all ones
+    for (i = 0; i < n; ++i)
     {
-        a[counter] = 1;
-        ja[counter] = 0;
-        ia[counter] = i;
-        counter++;
+        (*ja)[i] = i;
+        (*a)[i] = 1;
+    }
+
+#pragma omp parallel for schedule(dynamic, 1024) \
+    num_threads(runprms->nthreads)
+    for (i = 1; i < n; ++i)
+    {
+        int k, l, col, *rowJa = &(*ja)[(*ia)[i]];
+        double val, *rowA = &(*a)[(*ia)[i]];
+        SLE *neighbor;
 
         // diagonal element is always the rate sum
-        if(i > 0)
-        {
-            a[counter] = -1 * sites[i].rateSum;
-            ja[counter] = i;
-            ia[counter] = i;
-            counter++;
-        }
+        rowJa[0] = i;
+        rowA[0] = -1 * sites[i].rateSum;
 
-        // now the neighbors
+        // the neighbors, insertion sorted by column
         for (k = 0; k < sites[i].nNeighbors; ++k)
         {
             neighbor = &(sites[i].neighbors[k]);
+            col = neighbor->s;
+            val = SLE_reverse (neighbor, runprms)->rate;
 
-            if(neighbor->s->index == 0)
-                continue;
-            
-            a[counter] = neighbor->rate;
-            ja[counter] = neighbor->s->index;
-            ia[counter] = i;
-            counter++;
+            for (l = k; l >= 0 && rowJa[l] > col; --l)
+            {
+                rowJa[l + 1] = rowJa[l];
+                rowA[l + 1] = rowA[l];
+            }
+            rowJa[l + 1] = col;
+            rowA[l + 1] = val;
         }
     }
 
+    return nnz;
+}
+
+#ifdef WITH_LIS
+
+int
+solve_lis(RunParams * runprms, int nnz, int * ia, int * ja, double * a,
+          double * x)
+{
+    Params *prms = runprms->prms;
+    int i, it;
+    double *rhs;
+
+    rhs = calloc (runprms->nSites, sizeof (double));
+
     // create the right hand side
     rhs[0] = 1;
 
@@ -190,13 +251,13 @@ solve_lis(Site * sites, RunParams * runprms, int nnz, double * x)
     for (i = 0; i < runprms->nSites; ++i)
         x[i] = 1. / runprms->nSites;
 
-    int threads = omp_get_num_threads();
+    int threads = omp_get_max_threads();
     omp_set_num_threads(1);
 
     char options[200];
     sprintf(options, 
         "-i gmres -p ilu -tol %e -t %d -restart %d -maxiter %d", 
-        prms.be_abs_tol, 1, prms.be_it, prms.be_outer_it * prms.be_it);
+        prms->be_abs_tol, 1, prms->be_it, prms->be_outer_it * prms->be_it);
 
     LIS_INT argc = 1;
     char ** argv = (char *[]){""};
@@ -205,10 +266,11 @@ solve_lis(Site * sites, RunParams * runprms, int nnz, double * x)
 
     LIS_MATRIX lis_A;
     lis_matrix_create(0,&lis_A);
-    lis_matrix_set_type(lis_A, LIS_MATRIX_COO);
+    lis_matrix_set_type(lis_A, LIS_MATRIX_CSR);
     lis_matrix_set_size(lis_A,0,runprms->nSites);
 
-    lis_matrix_set_coo(nnz,ja,ia,a,lis_A);
+    // LIS works on the assembled arrays, they are freed by the caller
+    lis_matrix_set_csr(nnz,ia,ja,a,lis_A);
     lis_matrix_assemble(lis_A);
 
     LIS_VECTOR lis_b, lis_x;
@@ -228,14 +290,16 @@ solve_lis(Site * sites, RunParams * runprms, int nnz, double * x)
     for(i = 0; i < runprms->nSites; ++i)
         lis_vector_get_value(lis_x, i, &(x[i]));
 
+    lis_solver_destroy(solver);
+    lis_vector_destroy(lis_b);
+    lis_vector_destroy(lis_x);
+    lis_matrix_unset(lis_A);
+    lis_matrix_destroy(lis_A);
+
     lis_finalize();
 
     omp_set_num_threads(threads);
 
-
-    free (a);
-    free (ia);
-    free (ja);
     free (rhs);
 
     return it;
@@ -245,62 +309,14 @@ solve_lis(Site * sites, RunParams * runprms, int nnz, double * x)
 #endif /* WITH_LIS */
 
 int
-solve_mgmres(Site * sites, RunParams * runprms, int nnz, double * x)
+solve_mgmres(RunParams * runprms, int nnz, int * ia, int * ja, double * a,
+             double * x)
 {
-    int i, *ia, *ja, j, k, it;
-    double *a, *rhs;
-    SLE *neighbor, *neighbor2;
-
-    //allocate memory
-    ia = malloc (sizeof (int) * (runprms->nSites + 1));
-    ja = malloc (sizeof (int) * nnz);
-    a = malloc (sizeof (double) * nnz);
-    rhs = calloc (runprms->nSites, sizeof (double));
-    
-    // create the arrays
-    int counter = 0;
-    ia[0] = 0;
-    for (i = 0; i < runprms->nSites; ++i)
-    {
-        // first element is always 1
-        a[counter] = 1;
-        ja[counter] = i;
-        counter++;
-    }
-
-    for (i = 1; i < runprms->nSites; ++i)
-    {
-        // where does the current row begin?
-        ia[i] = counter;
-
-        // diagonal element is always the rate sum
-        a[counter] = -1 * sites[i].rateSum;
-        ja[counter] = i;
-        counter++;
-
-        // now the neighbors
-        for (k = 0; k < sites[i].nNeighbors; ++k)
-        {
-            neighbor = &(sites[i].neighbors[k]);
-
-            // this is an ugly, ugly hack because we need compressed
-            // row storage, which is exactly the wrong order compared
-            // to how our matrix has to be built. 
-            for (j = 0; j < neighbor->s->nNeighbors; ++j)
-            {
-                neighbor2 = &(neighbor->s->neighbors[j]);
+    Params *prms = runprms->prms;
+    int i, it;
+    double *rhs;
 
-                if (neighbor2->s->index == i)
-                {
-                    a[counter] = neighbor2->rate;
-                    break;
-                }
-            }
-            ja[counter] = neighbor->s->index;
-            counter++;
-        }
-    }
-    ia[runprms->nSites] = counter;
+    rhs = calloc (runprms->nSites, sizeof (double));
 
     // create the right hand side
     rhs[0] = 1;
@@ -311,14 +327,16 @@ solve_mgmres(Site * sites, RunParams * runprms, int nnz, double * x)
         x[i] = 1. / runprms->nSites;
     }
 
-    // perform the calculation
-    it = pmgmres_ilu_cr (runprms->nSites, nnz, ia, ja, a, x, rhs, 
-            prms.be_outer_it, prms.be_it, prms.be_abs_tol, prms.be_rel_tol);
-
+    // perform the calculation, threaded when there are threads to spare
+    if (runprms->nthreads > 1)
+        it = pmgmres_ilu_cr_omp (runprms->nSites, nnz, ia, ja, a, x, rhs,
+                prms->be_outer_it, prms->be_it, prms->be_abs_tol,
+                prms->be_rel_tol, runprms->nthreads);
+    else
+        it = pmgmres_ilu_cr (runprms->nSites, nnz, ia, ja, a, x, rhs, 
+                prms->be_outer_it, prms->be_it, prms->be_abs_tol,
+                prms->be_rel_tol);
 
-    free (a);
-    free (ia);
-    free (ja);
     free (rhs);
 
     return it;
@@ -27,7 +27,7 @@
 
 const char *gengetopt_args_info_purpose = "This software simulates hopping in disordered semiconductors with hopping on\nlocalized states. It uses Monte-Carlo simulation techniques. See the README.rst\nfile to learn more.";
 
-const char *gengetopt_args_info_usage = "Usage: HOP [-h|--help] [-V|--version] [-q|--quiet]\n         [-fSTRING|--conf_file=STRING] [-m|--memreq] [--rseed=LONG]\n         [-iINT|--nruns=INT] [-P|--parallel] [-tINT|--nthreads=INT]\n         [-FFLOAT|--field=FLOAT] [-TFLOAT|--temperature=FLOAT]\n         [-lINT|--length=INT] [-XINT|--X=INT] [-YINT|--Y=INT] [-ZINT|--Z=INT]\n         [-NINT|--nsites=INT] [-nINT|--ncarriers=INT] [--rc=FLOAT]\n         [-pFLOAT|--exponent=FLOAT] [-aFLOAT|--llength=FLOAT] [--gaussian]\n         [--lattice] [--removesoftpairs] [--softpairthreshold=FLOAT]\n         [--cutoutenergy=FLOAT] [--cutoutwidth=FLOAT]\n         [-ILONG|--simulation=LONG] [-RLONG|--relaxation=LONG]\n         [-xINT|--nreruns=INT] [--many] [--be] [--mgmres] [--be_it=LONG]\n         [--be_oit=LONG] [--tol_abs=FLOAT] [--tol_rel=FLOAT] [--an]\n         [-BFLOAT|--percolation_threshold=FLOAT]\n         [-oSTRING|--outputfolder=STRING] [--transitions]\n         [-ySTRING|--summary=STRING] [-cSTRING|--comment=STRING]";
+const char *gengetopt_args_info_usage = "Usage: HOP [-h|--help] [-V|--version] [-q|--quiet]\n         [-fSTRING|--conf_file=STRING] [-m|--memreq] [--rseed=LONG]\n         [-iINT|--nruns=INT] [-P|--parallel] [-tINT|--nthreads=INT]\n         [-FFLOAT|--field=FLOAT] [-TFLOAT|--temperature=FLOAT]\n         [--temperatures=STRING] [--fields=STRING] [--redrawenergies]\n         [--jobfile=STRING] [-lINT|--length=INT] [-XINT|--X=INT]\n         [-YINT|--Y=INT] [-ZINT|--Z=INT] [-NINT|--nsites=INT]\n         [-nINT|--ncarriers=INT] [--rc=FLOAT] [-pFLOAT|--exponent=FLOAT]\n         [-aFLOAT|--llength=FLOAT] [--gaussian] [--lattice] [--implicitlattice]\n         [--reorder] [--removesoftpairs] [--softpairthreshold=FLOAT]\n         [--ratemass=FLOAT] [--coarsegrain] [--clusterthreshold=FLOAT]\n         [--clustersize=INT] [--superbasin=INT] [--cutoutenergy=FLOAT]\n         [--cutoutwidth=FLOAT] [-ILONG|--simulation=LONG]\n         [-RLONG|--relaxation=LONG] [-xINT|--nreruns=INT] [--many] [--alias]\n         [--calendar] [--rejectionfree] [--kernelbench] [--fastrng]\n         [--counterrng] [--parallelreruns] [--interleave=INT] [--be] [--mgmres]\n         [--be_it=LONG] [--be_oit=LONG] [--tol_abs=FLOAT] [--tol_rel=FLOAT]\n         [--an] [-BFLOAT|--percolation_threshold=FLOAT]\n         [-oSTRING|--outputfolder=STRING] [--transitions]\n         [-ySTRING|--summary=STRING] [-cSTRING|--comment=STRING]";
 
 const char *gengetopt_args_info_versiontext = "";
 
@@ -47,6 +47,10 @@ const char *gengetopt_args_info_help[] = {
   "  Some external physical quantities.",
   "  -F, --field=FLOAT             The electric field strength in z-direction.\n                                  (default=`0.01')",
   "  -T, --temperature=FLOAT       The temperature of the simulation.\n                                  (default=`0.3')",
+  "      --temperatures=STRING     Comma-separated list of temperatures for a\n                                  sweep. The sites and their neighbors are\n                                  created only once per run, only the rates are\n                                  recalculated for every temperature. Overrides\n                                  -T",
+  "      --fields=STRING           Comma-separated list of field strengths for a\n                                  sweep like --temperatures, over all\n                                  combinations of both. Overrides -F",
+  "      --redrawenergies          Draw new site energies for every point of a\n                                  sweep (--temperatures, --fields)\n                                  (default=off)",
+  "      --jobfile=STRING          File with one configuration per line, each\n                                  setting any of -T, -F, -a and -n like on the\n                                  command line. The runs of all configurations\n                                  are distributed over the threads together",
   "\nSystem information:",
   "  Parameters describing the distribution of sites in the system",
   "  -l, --length=INT              This parameter specifies the length of the\n                                  (cubic) sample. If it parameter is set, the\n                                  options X,Y,Z are ignored!",
@@ -60,8 +64,15 @@ const char *gengetopt_args_info_help[] = {
   "  -a, --llength=FLOAT           Localization length of the sites, assumed equal\n                                  for all of them.  (default=`0.215')",
   "      --gaussian                Use a Gaussian DOS with std. dev. 1. g(x) =\n                                  exp(-1/2*(x)^2)  (default=off)",
   "      --lattice                 Distribute sites on a lattice with distance\n                                  unity. Control nearest neighbor hopping and\n                                  so on with --rc  (default=off)",
+  "      --implicitlattice         Like --lattice, but without stored neighbor\n                                  lists. The hopping rates are calculated\n                                  during the simulation from the neighbor\n                                  offsets within --rc  (default=off)",
+  "      --reorder                 Sort the sites along a Morton (Z-order) curve,\n                                  so that spatial neighbors are close in\n                                  memory. Output files keep the original order.\n                                  (default=off)",
   "      --removesoftpairs         Remove softpairs.  (default=off)",
   "      --softpairthreshold=FLOAT The min hopping rate ratio to define a softpair\n                                  (default=`0.95')",
+  "      --ratemass=FLOAT          Keep per site only the fastest neighbors, which\n                                  make up this fraction of its total hopping\n                                  rate. Both directions of a pair are kept if\n                                  one of them is needed. The discarded rate\n                                  mass is reported for every run.\n                                  (default=`1')",
+  "      --coarsegrain             Pass clusters of strongly coupled sites in one\n                                  step, with the exit times and exit sites of\n                                  their local master equation.  (default=off)",
+  "      --clusterthreshold=FLOAT  The min hopping rate ratio of the edges, which\n                                  connect the sites of a cluster\n                                  (default=`0.3')",
+  "      --clustersize=INT         The max number of sites of a cluster\n                                  (default=`10')",
+  "      --superbasin=INT          Let the carrier leave a set of at most\n                                  --clustersize sites in one step, once it\n                                  hopped this many times among them. 0 disables\n                                  it.  (default=`0')",
   "      --cutoutenergy=FLOAT      States below this energy will be cut out of the\n                                  DOS  (default=`0')",
   "      --cutoutwidth=FLOAT       The width of energies who are cutted.\n                                  (default=`0.5')",
   "\nMonte carlo simulation:",
@@ -70,6 +81,14 @@ const char *gengetopt_args_info_help[] = {
   "  -R, --relaxation=LONG         The number of hops to relax.\n                                  (default=`100000000')",
   "  -x, --nreruns=INT             How many times should the electron be placed at\n                                  some random starting position?  (default=`1')",
   "      --many                    Instead of using the mean field approach,\n                                  simulate multiple charge carriers. (slow!!!)\n                                  (default=off)",
+  "      --alias                   Select the destination of a hop in O(1) using\n                                  Walker alias tables instead of scanning the\n                                  neighbors sorted by rate.  (default=off)",
+  "      --calendar                Use a calendar queue instead of a 4-ary heap\n                                  for the events of the carriers in --many\n                                  mode. Can be faster for very large numbers of\n                                  carriers.  (default=off)",
+  "      --rejectionfree           Rejection-free kinetic Monte Carlo in --many\n                                  mode: carriers only attempt hops to\n                                  unoccupied neighbors and failed attempts are\n                                  accounted for analytically.  (default=off)",
+  "      --kernelbench             Run the first half of the relaxation with the\n                                  generic hopping step and the second half with\n                                  the specialized kernel and print the hops/sec\n                                  of both.  (default=off)",
+  "      --fastrng                 Draw the random numbers of the hopping loop in\n                                  blocks from vectorized xoshiro256++\n                                  generators, seeded from the GSL generator.\n                                  Faster, but the results differ from the\n                                  default for the same seed.  (default=off)",
+  "      --counterrng              Use counter-based Philox4x32-10 random number\n                                  streams addressed by (seed, run, rerun, site\n                                  block). The sites are generated in parallel\n                                  and the results do not depend on the number\n                                  of threads.  (default=off)",
+  "      --parallelreruns          Run the reruns (-x) of one realization as\n                                  independent walkers in parallel threads. All\n                                  threads share the sites and neighbor lists.\n                                  Meanfield mode only, transitions are not\n                                  counted.  (default=off)",
+  "      --interleave=INT          Number of walkers that one thread advances\n                                  round-robin, prefetching the memory of their\n                                  next hops. Values above one imply\n                                  --parallelreruns; the reruns are the walkers.\n                                  (default=`1')",
   "\nBalance equations:",
   "  These options only matter, when the solution is found by solving the balance\n  equations. (setting the --be flag)",
   "      --be                      Solve balance equations  (default=off)",
@@ -149,6 +168,10 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->nthreads_given = 0 ;
   args_info->field_given = 0 ;
   args_info->temperature_given = 0 ;
+  args_info->temperatures_given = 0 ;
+  args_info->fields_given = 0 ;
+  args_info->redrawenergies_given = 0 ;
+  args_info->jobfile_given = 0 ;
   args_info->length_given = 0 ;
   args_info->X_given = 0 ;
   args_info->Y_given = 0 ;
@@ -160,14 +183,29 @@ void clear_given (struct gengetopt_args_info *args_info)
   args_info->llength_given = 0 ;
   args_info->gaussian_given = 0 ;
   args_info->lattice_given = 0 ;
+  args_info->implicitlattice_given = 0 ;
+  args_info->reorder_given = 0 ;
   args_info->removesoftpairs_given = 0 ;
   args_info->softpairthreshold_given = 0 ;
+  args_info->ratemass_given = 0 ;
+  args_info->coarsegrain_given = 0 ;
+  args_info->clusterthreshold_given = 0 ;
+  args_info->clustersize_given = 0 ;
+  args_info->superbasin_given = 0 ;
   args_info->cutoutenergy_given = 0 ;
   args_info->cutoutwidth_given = 0 ;
   args_info->simulation_given = 0 ;
   args_info->relaxation_given = 0 ;
   args_info->nreruns_given = 0 ;
   args_info->many_given = 0 ;
+  args_info->alias_given = 0 ;
+  args_info->calendar_given = 0 ;
+  args_info->rejectionfree_given = 0 ;
+  args_info->kernelbench_given = 0 ;
+  args_info->fastrng_given = 0 ;
+  args_info->counterrng_given = 0 ;
+  args_info->parallelreruns_given = 0 ;
+  args_info->interleave_given = 0 ;
   args_info->be_given = 0 ;
   args_info->mgmres_given = 0 ;
   args_info->be_it_given = 0 ;
@@ -200,6 +238,13 @@ void clear_args (struct gengetopt_args_info *args_info)
   args_info->field_orig = NULL;
   args_info->temperature_arg = 0.3;
   args_info->temperature_orig = NULL;
+  args_info->temperatures_arg = NULL;
+  args_info->temperatures_orig = NULL;
+  args_info->fields_arg = NULL;
+  args_info->fields_orig = NULL;
+  args_info->redrawenergies_flag = 0;
+  args_info->jobfile_arg = NULL;
+  args_info->jobfile_orig = NULL;
   args_info->length_orig = NULL;
   args_info->X_arg = 50;
   args_info->X_orig = NULL;
@@ -219,9 +264,20 @@ void clear_args (struct gengetopt_args_info *args_info)
   args_info->llength_orig = NULL;
   args_info->gaussian_flag = 0;
   args_info->lattice_flag = 0;
+  args_info->implicitlattice_flag = 0;
+  args_info->reorder_flag = 0;
   args_info->removesoftpairs_flag = 0;
   args_info->softpairthreshold_arg = 0.95;
   args_info->softpairthreshold_orig = NULL;
+  args_info->ratemass_arg = 1;
+  args_info->ratemass_orig = NULL;
+  args_info->coarsegrain_flag = 0;
+  args_info->clusterthreshold_arg = 0.3;
+  args_info->clusterthreshold_orig = NULL;
+  args_info->clustersize_arg = 10;
+  args_info->clustersize_orig = NULL;
+  args_info->superbasin_arg = 0;
+  args_info->superbasin_orig = NULL;
   args_info->cutoutenergy_arg = 0;
   args_info->cutoutenergy_orig = NULL;
   args_info->cutoutwidth_arg = 0.5;
@@ -233,6 +289,15 @@ void clear_args (struct gengetopt_args_info *args_info)
   args_info->nreruns_arg = 1;
   args_info->nreruns_orig = NULL;
   args_info->many_flag = 0;
+  args_info->alias_flag = 0;
+  args_info->calendar_flag = 0;
+  args_info->rejectionfree_flag = 0;
+  args_info->kernelbench_flag = 0;
+  args_info->fastrng_flag = 0;
+  args_info->counterrng_flag = 0;
+  args_info->parallelreruns_flag = 0;
+  args_info->interleave_arg = 1;
+  args_info->interleave_orig = NULL;
   args_info->be_flag = 0;
   args_info->mgmres_flag = 0;
   args_info->be_it_arg = 300;
@@ -272,37 +337,56 @@ void init_args_info(struct gengetopt_args_info *args_info)
   args_info->nthreads_help = gengetopt_args_info_help[8] ;
   args_info->field_help = gengetopt_args_info_help[11] ;
   args_info->temperature_help = gengetopt_args_info_help[12] ;
-  args_info->length_help = gengetopt_args_info_help[15] ;
-  args_info->X_help = gengetopt_args_info_help[16] ;
-  args_info->Y_help = gengetopt_args_info_help[17] ;
-  args_info->Z_help = gengetopt_args_info_help[18] ;
-  args_info->nsites_help = gengetopt_args_info_help[19] ;
-  args_info->ncarriers_help = gengetopt_args_info_help[20] ;
-  args_info->rc_help = gengetopt_args_info_help[21] ;
-  args_info->exponent_help = gengetopt_args_info_help[22] ;
-  args_info->llength_help = gengetopt_args_info_help[23] ;
-  args_info->gaussian_help = gengetopt_args_info_help[24] ;
-  args_info->lattice_help = gengetopt_args_info_help[25] ;
-  args_info->removesoftpairs_help = gengetopt_args_info_help[26] ;
-  args_info->softpairthreshold_help = gengetopt_args_info_help[27] ;
-  args_info->cutoutenergy_help = gengetopt_args_info_help[28] ;
-  args_info->cutoutwidth_help = gengetopt_args_info_help[29] ;
-  args_info->simulation_help = gengetopt_args_info_help[32] ;
-  args_info->relaxation_help = gengetopt_args_info_help[33] ;
-  args_info->nreruns_help = gengetopt_args_info_help[34] ;
-  args_info->many_help = gengetopt_args_info_help[35] ;
-  args_info->be_help = gengetopt_args_info_help[38] ;
-  args_info->mgmres_help = gengetopt_args_info_help[39] ;
-  args_info->be_it_help = gengetopt_args_info_help[40] ;
-  args_info->be_oit_help = gengetopt_args_info_help[41] ;
-  args_info->tol_abs_help = gengetopt_args_info_help[42] ;
-  args_info->tol_rel_help = gengetopt_args_info_help[43] ;
-  args_info->an_help = gengetopt_args_info_help[46] ;
-  args_info->percolation_threshold_help = gengetopt_args_info_help[47] ;
-  args_info->outputfolder_help = gengetopt_args_info_help[49] ;
-  args_info->transitions_help = gengetopt_args_info_help[50] ;
-  args_info->summary_help = gengetopt_args_info_help[51] ;
-  args_info->comment_help = gengetopt_args_info_help[52] ;
+  args_info->temperatures_help = gengetopt_args_info_help[13] ;
+  args_info->fields_help = gengetopt_args_info_help[14] ;
+  args_info->redrawenergies_help = gengetopt_args_info_help[15] ;
+  args_info->jobfile_help = gengetopt_args_info_help[16] ;
+  args_info->length_help = gengetopt_args_info_help[19] ;
+  args_info->X_help = gengetopt_args_info_help[20] ;
+  args_info->Y_help = gengetopt_args_info_help[21] ;
+  args_info->Z_help = gengetopt_args_info_help[22] ;
+  args_info->nsites_help = gengetopt_args_info_help[23] ;
+  args_info->ncarriers_help = gengetopt_args_info_help[24] ;
+  args_info->rc_help = gengetopt_args_info_help[25] ;
+  args_info->exponent_help = gengetopt_args_info_help[26] ;
+  args_info->llength_help = gengetopt_args_info_help[27] ;
+  args_info->gaussian_help = gengetopt_args_info_help[28] ;
+  args_info->lattice_help = gengetopt_args_info_help[29] ;
+  args_info->implicitlattice_help = gengetopt_args_info_help[30] ;
+  args_info->reorder_help = gengetopt_args_info_help[31] ;
+  args_info->removesoftpairs_help = gengetopt_args_info_help[32] ;
+  args_info->softpairthreshold_help = gengetopt_args_info_help[33] ;
+  args_info->ratemass_help = gengetopt_args_info_help[34] ;
+  args_info->coarsegrain_help = gengetopt_args_info_help[35] ;
+  args_info->clusterthreshold_help = gengetopt_args_info_help[36] ;
+  args_info->clustersize_help = gengetopt_args_info_help[37] ;
+  args_info->superbasin_help = gengetopt_args_info_help[38] ;
+  args_info->cutoutenergy_help = gengetopt_args_info_help[39] ;
+  args_info->cutoutwidth_help = gengetopt_args_info_help[40] ;
+  args_info->simulation_help = gengetopt_args_info_help[43] ;
+  args_info->relaxation_help = gengetopt_args_info_help[44] ;
+  args_info->nreruns_help = gengetopt_args_info_help[45] ;
+  args_info->many_help = gengetopt_args_info_help[46] ;
+  args_info->alias_help = gengetopt_args_info_help[47] ;
+  args_info->calendar_help = gengetopt_args_info_help[48] ;
+  args_info->rejectionfree_help = gengetopt_args_info_help[49] ;
+  args_info->kernelbench_help = gengetopt_args_info_help[50] ;
+  args_info->fastrng_help = gengetopt_args_info_help[51] ;
+  args_info->counterrng_help = gengetopt_args_info_help[52] ;
+  args_info->parallelreruns_help = gengetopt_args_info_help[53] ;
+  args_info->interleave_help = gengetopt_args_info_help[54] ;
+  args_info->be_help = gengetopt_args_info_help[57] ;
+  args_info->mgmres_help = gengetopt_args_info_help[58] ;
+  args_info->be_it_help = gengetopt_args_info_help[59] ;
+  args_info->be_oit_help = gengetopt_args_info_help[60] ;
+  args_info->tol_abs_help = gengetopt_args_info_help[61] ;
+  args_info->tol_rel_help = gengetopt_args_info_help[62] ;
+  args_info->an_help = gengetopt_args_info_help[65] ;
+  args_info->percolation_threshold_help = gengetopt_args_info_help[66] ;
+  args_info->outputfolder_help = gengetopt_args_info_help[68] ;
+  args_info->transitions_help = gengetopt_args_info_help[69] ;
+  args_info->summary_help = gengetopt_args_info_help[70] ;
+  args_info->comment_help = gengetopt_args_info_help[71] ;
   
 }
 
@@ -393,6 +477,12 @@ cmdline_parser_release (struct gengetopt_args_info *args_info)
   free_string_field (&(args_info->nthreads_orig));
   free_string_field (&(args_info->field_orig));
   free_string_field (&(args_info->temperature_orig));
+  free_string_field (&(args_info->temperatures_arg));
+  free_string_field (&(args_info->temperatures_orig));
+  free_string_field (&(args_info->fields_arg));
+  free_string_field (&(args_info->fields_orig));
+  free_string_field (&(args_info->jobfile_arg));
+  free_string_field (&(args_info->jobfile_orig));
   free_string_field (&(args_info->length_orig));
   free_string_field (&(args_info->X_orig));
   free_string_field (&(args_info->Y_orig));
@@ -403,11 +493,16 @@ cmdline_parser_release (struct gengetopt_args_info *args_info)
   free_string_field (&(args_info->exponent_orig));
   free_string_field (&(args_info->llength_orig));
   free_string_field (&(args_info->softpairthreshold_orig));
+  free_string_field (&(args_info->ratemass_orig));
+  free_string_field (&(args_info->clusterthreshold_orig));
+  free_string_field (&(args_info->clustersize_orig));
+  free_string_field (&(args_info->superbasin_orig));
   free_string_field (&(args_info->cutoutenergy_orig));
   free_string_field (&(args_info->cutoutwidth_orig));
   free_string_field (&(args_info->simulation_orig));
   free_string_field (&(args_info->relaxation_orig));
   free_string_field (&(args_info->nreruns_orig));
+  free_string_field (&(args_info->interleave_orig));
   free_string_field (&(args_info->be_it_orig));
   free_string_field (&(args_info->be_oit_orig));
   free_string_field (&(args_info->tol_abs_orig));
@@ -471,6 +566,14 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "field", args_info->field_orig, 0);
   if (args_info->temperature_given)
     write_into_file(outfile, "temperature", args_info->temperature_orig, 0);
+  if (args_info->temperatures_given)
+    write_into_file(outfile, "temperatures", args_info->temperatures_orig, 0);
+  if (args_info->fields_given)
+    write_into_file(outfile, "fields", args_info->fields_orig, 0);
+  if (args_info->redrawenergies_given)
+    write_into_file(outfile, "redrawenergies", 0, 0 );
+  if (args_info->jobfile_given)
+    write_into_file(outfile, "jobfile", args_info->jobfile_orig, 0);
   if (args_info->length_given)
     write_into_file(outfile, "length", args_info->length_orig, 0);
   if (args_info->X_given)
@@ -493,10 +596,24 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "gaussian", 0, 0 );
   if (args_info->lattice_given)
     write_into_file(outfile, "lattice", 0, 0 );
+  if (args_info->implicitlattice_given)
+    write_into_file(outfile, "implicitlattice", 0, 0 );
+  if (args_info->reorder_given)
+    write_into_file(outfile, "reorder", 0, 0 );
   if (args_info->removesoftpairs_given)
     write_into_file(outfile, "removesoftpairs", 0, 0 );
   if (args_info->softpairthreshold_given)
     write_into_file(outfile, "softpairthreshold", args_info->softpairthreshold_orig, 0);
+  if (args_info->ratemass_given)
+    write_into_file(outfile, "ratemass", args_info->ratemass_orig, 0);
+  if (args_info->coarsegrain_given)
+    write_into_file(outfile, "coarsegrain", 0, 0 );
+  if (args_info->clusterthreshold_given)
+    write_into_file(outfile, "clusterthreshold", args_info->clusterthreshold_orig, 0);
+  if (args_info->clustersize_given)
+    write_into_file(outfile, "clustersize", args_info->clustersize_orig, 0);
+  if (args_info->superbasin_given)
+    write_into_file(outfile, "superbasin", args_info->superbasin_orig, 0);
   if (args_info->cutoutenergy_given)
     write_into_file(outfile, "cutoutenergy", args_info->cutoutenergy_orig, 0);
   if (args_info->cutoutwidth_given)
@@ -509,6 +626,22 @@ cmdline_parser_dump(FILE *outfile, struct gengetopt_args_info *args_info)
     write_into_file(outfile, "nreruns", args_info->nreruns_orig, 0);
   if (args_info->many_given)
     write_into_file(outfile, "many", 0, 0 );
+  if (args_info->alias_given)
+    write_into_file(outfile, "alias", 0, 0 );
+  if (args_info->calendar_given)
+    write_into_file(outfile, "calendar", 0, 0 );
+  if (args_info->rejectionfree_given)
+    write_into_file(outfile, "rejectionfree", 0, 0 );
+  if (args_info->kernelbench_given)
+    write_into_file(outfile, "kernelbench", 0, 0 );
+  if (args_info->fastrng_given)
+    write_into_file(outfile, "fastrng", 0, 0 );
+  if (args_info->counterrng_given)
+    write_into_file(outfile, "counterrng", 0, 0 );
+  if (args_info->parallelreruns_given)
+    write_into_file(outfile, "parallelreruns", 0, 0 );
+  if (args_info->interleave_given)
+    write_into_file(outfile, "interleave", args_info->interleave_orig, 0);
   if (args_info->be_given)
     write_into_file(outfile, "be", 0, 0 );
   if (args_info->mgmres_given)
@@ -806,6 +939,10 @@ cmdline_parser_internal (
         { "nthreads",	1, NULL, 't' },
         { "field",	1, NULL, 'F' },
         { "temperature",	1, NULL, 'T' },
+        { "temperatures",	1, NULL, 0 },
+        { "fields",	1, NULL, 0 },
+        { "redrawenergies",	0, NULL, 0 },
+        { "jobfile",	1, NULL, 0 },
         { "length",	1, NULL, 'l' },
         { "X",	1, NULL, 'X' },
         { "Y",	1, NULL, 'Y' },
@@ -817,14 +954,29 @@ cmdline_parser_internal (
         { "llength",	1, NULL, 'a' },
         { "gaussian",	0, NULL, 0 },
         { "lattice",	0, NULL, 0 },
+        { "implicitlattice",	0, NULL, 0 },
+        { "reorder",	0, NULL, 0 },
         { "removesoftpairs",	0, NULL, 0 },
         { "softpairthreshold",	1, NULL, 0 },
+        { "ratemass",	1, NULL, 0 },
+        { "coarsegrain",	0, NULL, 0 },
+        { "clusterthreshold",	1, NULL, 0 },
+        { "clustersize",	1, NULL, 0 },
+        { "superbasin",	1, NULL, 0 },
         { "cutoutenergy",	1, NULL, 0 },
         { "cutoutwidth",	1, NULL, 0 },
         { "simulation",	1, NULL, 'I' },
         { "relaxation",	1, NULL, 'R' },
         { "nreruns",	1, NULL, 'x' },
         { "many",	0, NULL, 0 },
+        { "alias",	0, NULL, 0 },
+        { "calendar",	0, NULL, 0 },
+        { "rejectionfree",	0, NULL, 0 },
+        { "kernelbench",	0, NULL, 0 },
+        { "fastrng",	0, NULL, 0 },
+        { "counterrng",	0, NULL, 0 },
+        { "parallelreruns",	0, NULL, 0 },
+        { "interleave",	1, NULL, 0 },
         { "be",	0, NULL, 0 },
         { "mgmres",	0, NULL, 0 },
         { "be_it",	1, NULL, 0 },
@@ -1141,6 +1293,60 @@ cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* Comma-separated list of temperatures for a sweep. The sites and their neighbors are created only once per run, only the rates are recalculated for every temperature. Overrides -T.  */
+          else if (strcmp (long_options[option_index].name, "temperatures") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->temperatures_arg), 
+                 &(args_info->temperatures_orig), &(args_info->temperatures_given),
+                &(local_args_info.temperatures_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "temperatures", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Comma-separated list of field strengths for a sweep like --temperatures, over all combinations of both. Overrides -F.  */
+          else if (strcmp (long_options[option_index].name, "fields") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->fields_arg), 
+                 &(args_info->fields_orig), &(args_info->fields_given),
+                &(local_args_info.fields_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "fields", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Draw new site energies for every point of a sweep (--temperatures, --fields).  */
+          else if (strcmp (long_options[option_index].name, "redrawenergies") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->redrawenergies_flag), 0, &(args_info->redrawenergies_given),
+                &(local_args_info.redrawenergies_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "redrawenergies", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* File with one configuration per line, each setting any of -T, -F, -a and -n like on the command line. The runs of all configurations are distributed over the threads together.  */
+          else if (strcmp (long_options[option_index].name, "jobfile") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->jobfile_arg), 
+                 &(args_info->jobfile_orig), &(args_info->jobfile_given),
+                &(local_args_info.jobfile_given), optarg, 0, 0, ARG_STRING,
+                check_ambiguity, override, 0, 0,
+                "jobfile", '-',
+                additional_error))
+              goto failure;
+          
           }
           /* Determines up to which distance sites should be neighbors..  */
           else if (strcmp (long_options[option_index].name, "rc") == 0)
@@ -1179,6 +1385,30 @@ cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* Like --lattice, but without stored neighbor lists. The hopping rates are calculated during the simulation from the neighbor offsets within --rc.  */
+          else if (strcmp (long_options[option_index].name, "implicitlattice") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->implicitlattice_flag), 0, &(args_info->implicitlattice_given),
+                &(local_args_info.implicitlattice_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "implicitlattice", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Sort the sites along a Morton (Z-order) curve, so that spatial neighbors are close in memory. Output files keep the original order..  */
+          else if (strcmp (long_options[option_index].name, "reorder") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->reorder_flag), 0, &(args_info->reorder_given),
+                &(local_args_info.reorder_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "reorder", '-',
+                additional_error))
+              goto failure;
+          
           }
           /* Remove softpairs..  */
           else if (strcmp (long_options[option_index].name, "removesoftpairs") == 0)
@@ -1205,6 +1435,74 @@ cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* Keep per site only the fastest neighbors, which make up this fraction of its total hopping rate. Both directions of a pair are kept if one of them is needed. The discarded rate mass is reported for every run..  */
+          else if (strcmp (long_options[option_index].name, "ratemass") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->ratemass_arg), 
+                 &(args_info->ratemass_orig), &(args_info->ratemass_given),
+                &(local_args_info.ratemass_given), optarg, 0, "1", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "ratemass", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Pass clusters of strongly coupled sites in one step, with the exit times and exit sites of their local master equation..  */
+          else if (strcmp (long_options[option_index].name, "coarsegrain") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->coarsegrain_flag), 0, &(args_info->coarsegrain_given),
+                &(local_args_info.coarsegrain_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "coarsegrain", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* The min hopping rate ratio of the edges, which connect the sites of a cluster.  */
+          else if (strcmp (long_options[option_index].name, "clusterthreshold") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->clusterthreshold_arg), 
+                 &(args_info->clusterthreshold_orig), &(args_info->clusterthreshold_given),
+                &(local_args_info.clusterthreshold_given), optarg, 0, "0.3", ARG_FLOAT,
+                check_ambiguity, override, 0, 0,
+                "clusterthreshold", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* The max number of sites of a cluster.  */
+          else if (strcmp (long_options[option_index].name, "clustersize") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->clustersize_arg), 
+                 &(args_info->clustersize_orig), &(args_info->clustersize_given),
+                &(local_args_info.clustersize_given), optarg, 0, "10", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "clustersize", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Let the carrier leave a set of at most --clustersize sites in one step, once it hopped this many times among them. 0 disables it..  */
+          else if (strcmp (long_options[option_index].name, "superbasin") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->superbasin_arg), 
+                 &(args_info->superbasin_orig), &(args_info->superbasin_given),
+                &(local_args_info.superbasin_given), optarg, 0, "0", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "superbasin", '-',
+                additional_error))
+              goto failure;
+          
           }
           /* States below this energy will be cut out of the DOS.  */
           else if (strcmp (long_options[option_index].name, "cutoutenergy") == 0)
@@ -1245,6 +1543,104 @@ cmdline_parser_internal (
                 additional_error))
               goto failure;
           
+          }
+          /* Select the destination of a hop in O(1) using Walker alias tables instead of scanning the neighbors sorted by rate..  */
+          else if (strcmp (long_options[option_index].name, "alias") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->alias_flag), 0, &(args_info->alias_given),
+                &(local_args_info.alias_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "alias", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Use a calendar queue instead of a 4-ary heap for the events of the carriers in --many mode. Can be faster for very large numbers of carriers..  */
+          else if (strcmp (long_options[option_index].name, "calendar") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->calendar_flag), 0, &(args_info->calendar_given),
+                &(local_args_info.calendar_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "calendar", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Rejection-free kinetic Monte Carlo in --many mode: carriers only attempt hops to unoccupied neighbors and failed attempts are accounted for analytically..  */
+          else if (strcmp (long_options[option_index].name, "rejectionfree") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->rejectionfree_flag), 0, &(args_info->rejectionfree_given),
+                &(local_args_info.rejectionfree_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "rejectionfree", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Run the first half of the relaxation with the generic hopping step and the second half with the specialized kernel and print the hops/sec of both..  */
+          else if (strcmp (long_options[option_index].name, "kernelbench") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->kernelbench_flag), 0, &(args_info->kernelbench_given),
+                &(local_args_info.kernelbench_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "kernelbench", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Draw the random numbers of the hopping loop in blocks from vectorized xoshiro256++ generators, seeded from the GSL generator. Faster, but the results differ from the default for the same seed..  */
+          else if (strcmp (long_options[option_index].name, "fastrng") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->fastrng_flag), 0, &(args_info->fastrng_given),
+                &(local_args_info.fastrng_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "fastrng", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Use counter-based Philox4x32-10 random number streams addressed by (seed, run, rerun, site block). The sites are generated in parallel and the results do not depend on the number of threads..  */
+          else if (strcmp (long_options[option_index].name, "counterrng") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->counterrng_flag), 0, &(args_info->counterrng_given),
+                &(local_args_info.counterrng_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "counterrng", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Run the reruns (-x) of one realization as independent walkers in parallel threads. All threads share the sites and neighbor lists. Meanfield mode only, transitions are not counted..  */
+          else if (strcmp (long_options[option_index].name, "parallelreruns") == 0)
+          {
+          
+          
+            if (update_arg((void *)&(args_info->parallelreruns_flag), 0, &(args_info->parallelreruns_given),
+                &(local_args_info.parallelreruns_given), optarg, 0, 0, ARG_FLAG,
+                check_ambiguity, override, 1, 0, "parallelreruns", '-',
+                additional_error))
+              goto failure;
+          
+          }
+          /* Number of walkers that one thread advances round-robin, prefetching the memory of their next hops. Values above one imply --parallelreruns; the reruns are the walkers..  */
+          else if (strcmp (long_options[option_index].name, "interleave") == 0)
+          {
+          
+          
+            if (update_arg( (void *)&(args_info->interleave_arg), 
+                 &(args_info->interleave_orig), &(args_info->interleave_given),
+                &(local_args_info.interleave_given), optarg, 0, "1", ARG_INT,
+                check_ambiguity, override, 0, 0,
+                "interleave", '-',
+                additional_error))
+              goto failure;
+          
           }
           /* Solve balance equations.  */
           else if (strcmp (long_options[option_index].name, "be") == 0)
@@ -63,6 +63,17 @@ struct gengetopt_args_info
   float temperature_arg;	/**< @brief The temperature of the simulation. (default='0.3').  */
   char * temperature_orig;	/**< @brief The temperature of the simulation. original value given at command line.  */
   const char *temperature_help; /**< @brief The temperature of the simulation. help description.  */
+  char * temperatures_arg;	/**< @brief Comma-separated list of temperatures for a sweep. The sites and their neighbors are created only once per run, only the rates are recalculated for every temperature. Overrides -T.  */
+  char * temperatures_orig;	/**< @brief Comma-separated list of temperatures for a sweep. The sites and their neighbors are created only once per run, only the rates are recalculated for every temperature. Overrides -T original value given at command line.  */
+  const char *temperatures_help; /**< @brief Comma-separated list of temperatures for a sweep. The sites and their neighbors are created only once per run, only the rates are recalculated for every temperature. Overrides -T help description.  */
+  char * fields_arg;	/**< @brief Comma-separated list of field strengths for a sweep like --temperatures, over all combinations of both. Overrides -F.  */
+  char * fields_orig;	/**< @brief Comma-separated list of field strengths for a sweep like --temperatures, over all combinations of both. Overrides -F original value given at command line.  */
+  const char *fields_help; /**< @brief Comma-separated list of field strengths for a sweep like --temperatures, over all combinations of both. Overrides -F help description.  */
+  int redrawenergies_flag;	/**< @brief Draw new site energies for every point of a sweep (--temperatures, --fields) (default=off).  */
+  const char *redrawenergies_help; /**< @brief Draw new site energies for every point of a sweep (--temperatures, --fields) help description.  */
+  char * jobfile_arg;	/**< @brief File with one configuration per line, each setting any of -T, -F, -a and -n like on the command line. The runs of all configurations are distributed over the threads together.  */
+  char * jobfile_orig;	/**< @brief File with one configuration per line, each setting any of -T, -F, -a and -n like on the command line. The runs of all configurations are distributed over the threads together original value given at command line.  */
+  const char *jobfile_help; /**< @brief File with one configuration per line, each setting any of -T, -F, -a and -n like on the command line. The runs of all configurations are distributed over the threads together help description.  */
   int length_arg;	/**< @brief This parameter specifies the length of the (cubic) sample. If it parameter is set, the options X,Y,Z are ignored!.  */
   char * length_orig;	/**< @brief This parameter specifies the length of the (cubic) sample. If it parameter is set, the options X,Y,Z are ignored! original value given at command line.  */
   const char *length_help; /**< @brief This parameter specifies the length of the (cubic) sample. If it parameter is set, the options X,Y,Z are ignored! help description.  */
@@ -94,11 +105,29 @@ struct gengetopt_args_info
   const char *gaussian_help; /**< @brief Use a Gaussian DOS with std. dev. 1. g(x) = exp(-1/2*(x)^2) help description.  */
   int lattice_flag;	/**< @brief Distribute sites on a lattice with distance unity. Control nearest neighbor hopping and so on with --rc (default=off).  */
   const char *lattice_help; /**< @brief Distribute sites on a lattice with distance unity. Control nearest neighbor hopping and so on with --rc help description.  */
+  int implicitlattice_flag;	/**< @brief Like --lattice, but without stored neighbor lists. The hopping rates are calculated during the simulation from the neighbor offsets within --rc (default=off).  */
+  const char *implicitlattice_help; /**< @brief Like --lattice, but without stored neighbor lists. The hopping rates are calculated during the simulation from the neighbor offsets within --rc help description.  */
+  int reorder_flag;	/**< @brief Sort the sites along a Morton (Z-order) curve, so that spatial neighbors are close in memory. Output files keep the original order. (default=off).  */
+  const char *reorder_help; /**< @brief Sort the sites along a Morton (Z-order) curve, so that spatial neighbors are close in memory. Output files keep the original order. help description.  */
   int removesoftpairs_flag;	/**< @brief Remove softpairs. (default=off).  */
   const char *removesoftpairs_help; /**< @brief Remove softpairs. help description.  */
   float softpairthreshold_arg;	/**< @brief The min hopping rate ratio to define a softpair (default='0.95').  */
   char * softpairthreshold_orig;	/**< @brief The min hopping rate ratio to define a softpair original value given at command line.  */
   const char *softpairthreshold_help; /**< @brief The min hopping rate ratio to define a softpair help description.  */
+  float ratemass_arg;	/**< @brief Keep per site only the fastest neighbors, which make up this fraction of its total hopping rate. Both directions of a pair are kept if one of them is needed. The discarded rate mass is reported for every run. (default='1').  */
+  char * ratemass_orig;	/**< @brief Keep per site only the fastest neighbors, which make up this fraction of its total hopping rate. Both directions of a pair are kept if one of them is needed. The discarded rate mass is reported for every run. original value given at command line.  */
+  const char *ratemass_help; /**< @brief Keep per site only the fastest neighbors, which make up this fraction of its total hopping rate. Both directions of a pair are kept if one of them is needed. The discarded rate mass is reported for every run. help description.  */
+  int coarsegrain_flag;	/**< @brief Pass clusters of strongly coupled sites in one step, with the exit times and exit sites of their local master equation. (default=off).  */
+  const char *coarsegrain_help; /**< @brief Pass clusters of strongly coupled sites in one step, with the exit times and exit sites of their local master equation. help description.  */
+  float clusterthreshold_arg;	/**< @brief The min hopping rate ratio of the edges, which connect the sites of a cluster (default='0.3').  */
+  char * clusterthreshold_orig;	/**< @brief The min hopping rate ratio of the edges, which connect the sites of a cluster original value given at command line.  */
+  const char *clusterthreshold_help; /**< @brief The min hopping rate ratio of the edges, which connect the sites of a cluster help description.  */
+  int clustersize_arg;	/**< @brief The max number of sites of a cluster (default='10').  */
+  char * clustersize_orig;	/**< @brief The max number of sites of a cluster original value given at command line.  */
+  const char *clustersize_help; /**< @brief The max number of sites of a cluster help description.  */
+  int superbasin_arg;	/**< @brief Let the carrier leave a set of at most --clustersize sites in one step, once it hopped this many times among them. 0 disables it. (default='0').  */
+  char * superbasin_orig;	/**< @brief Let the carrier leave a set of at most --clustersize sites in one step, once it hopped this many times among them. 0 disables it. original value given at command line.  */
+  const char *superbasin_help; /**< @brief Let the carrier leave a set of at most --clustersize sites in one step, once it hopped this many times among them. 0 disables it. help description.  */
   float cutoutenergy_arg;	/**< @brief States below this energy will be cut out of the DOS (default='0').  */
   char * cutoutenergy_orig;	/**< @brief States below this energy will be cut out of the DOS original value given at command line.  */
   const char *cutoutenergy_help; /**< @brief States below this energy will be cut out of the DOS help description.  */
@@ -116,6 +145,23 @@ struct gengetopt_args_info
   const char *nreruns_help; /**< @brief How many times should the electron be placed at some random starting position? help description.  */
   int many_flag;	/**< @brief Instead of using the mean field approach, simulate multiple charge carriers. (slow!!!) (default=off).  */
   const char *many_help; /**< @brief Instead of using the mean field approach, simulate multiple charge carriers. (slow!!!) help description.  */
+  int alias_flag;	/**< @brief Select the destination of a hop in O(1) using Walker alias tables instead of scanning the neighbors sorted by rate. (default=off).  */
+  const char *alias_help; /**< @brief Select the destination of a hop in O(1) using Walker alias tables instead of scanning the neighbors sorted by rate. help description.  */
+  int calendar_flag;	/**< @brief Use a calendar queue instead of a 4-ary heap for the events of the carriers in --many mode. Can be faster for very large numbers of carriers. (default=off).  */
+  const char *calendar_help; /**< @brief Use a calendar queue instead of a 4-ary heap for the events of the carriers in --many mode. Can be faster for very large numbers of carriers. help description.  */
+  int rejectionfree_flag;	/**< @brief Rejection-free kinetic Monte Carlo in --many mode: carriers only attempt hops to unoccupied neighbors and failed attempts are accounted for analytically. (default=off).  */
+  const char *rejectionfree_help; /**< @brief Rejection-free kinetic Monte Carlo in --many mode: carriers only attempt hops to unoccupied neighbors and failed attempts are accounted for analytically. help description.  */
+  int kernelbench_flag;	/**< @brief Run the first half of the relaxation with the generic hopping step and the second half with the specialized kernel and print the hops/sec of both. (default=off).  */
+  const char *kernelbench_help; /**< @brief Run the first half of the relaxation with the generic hopping step and the second half with the specialized kernel and print the hops/sec of both. help description.  */
+  int fastrng_flag;	/**< @brief Draw the random numbers of the hopping loop in blocks from vectorized xoshiro256++ generators, seeded from the GSL generator. Faster, but the results differ from the default for the same seed. (default=off).  */
+  const char *fastrng_help; /**< @brief Draw the random numbers of the hopping loop in blocks from vectorized xoshiro256++ generators, seeded from the GSL generator. Faster, but the results differ from the default for the same seed. help description.  */
+  int counterrng_flag;	/**< @brief Use counter-based Philox4x32-10 random number streams addressed by (seed, run, rerun, site block). The sites are generated in parallel and the results do not depend on the number of threads. (default=off).  */
+  const char *counterrng_help; /**< @brief Use counter-based Philox4x32-10 random number streams addressed by (seed, run, rerun, site block). The sites are generated in parallel and the results do not depend on the number of threads. help description.  */
+  int parallelreruns_flag;	/**< @brief Run the reruns (-x) of one realization as independent walkers in parallel threads. All threads share the sites and neighbor lists. Meanfield mode only, transitions are not counted. (default=off).  */
+  const char *parallelreruns_help; /**< @brief Run the reruns (-x) of one realization as independent walkers in parallel threads. All threads share the sites and neighbor lists. Meanfield mode only, transitions are not counted. help description.  */
+  int interleave_arg;	/**< @brief Number of walkers that one thread advances round-robin, prefetching the memory of their next hops. Values above one imply --parallelreruns; the reruns are the walkers. (default='1').  */
+  char * interleave_orig;	/**< @brief Number of walkers that one thread advances round-robin, prefetching the memory of their next hops. Values above one imply --parallelreruns; the reruns are the walkers. original value given at command line.  */
+  const char *interleave_help; /**< @brief Number of walkers that one thread advances round-robin, prefetching the memory of their next hops. Values above one imply --parallelreruns; the reruns are the walkers. help description.  */
   int be_flag;	/**< @brief Solve balance equations (default=off).  */
   const char *be_help; /**< @brief Solve balance equations help description.  */
   int mgmres_flag;	/**< @brief Force use of mgmres instead of lis (default=off).  */
@@ -160,6 +206,10 @@ struct gengetopt_args_info
   unsigned int nthreads_given ;	/**< @brief Whether nthreads was given.  */
   unsigned int field_given ;	/**< @brief Whether field was given.  */
   unsigned int temperature_given ;	/**< @brief Whether temperature was given.  */
+  unsigned int temperatures_given ;	/**< @brief Whether temperatures was given.  */
+  unsigned int fields_given ;	/**< @brief Whether fields was given.  */
+  unsigned int redrawenergies_given ;	/**< @brief Whether redrawenergies was given.  */
+  unsigned int jobfile_given ;	/**< @brief Whether jobfile was given.  */
   unsigned int length_given ;	/**< @brief Whether length was given.  */
   unsigned int X_given ;	/**< @brief Whether X was given.  */
   unsigned int Y_given ;	/**< @brief Whether Y was given.  */
@@ -171,14 +221,29 @@ struct gengetopt_args_info
   unsigned int llength_given ;	/**< @brief Whether llength was given.  */
   unsigned int gaussian_given ;	/**< @brief Whether gaussian was given.  */
   unsigned int lattice_given ;	/**< @brief Whether lattice was given.  */
+  unsigned int implicitlattice_given ;	/**< @brief Whether implicitlattice was given.  */
+  unsigned int reorder_given ;	/**< @brief Whether reorder was given.  */
   unsigned int removesoftpairs_given ;	/**< @brief Whether removesoftpairs was given.  */
   unsigned int softpairthreshold_given ;	/**< @brief Whether softpairthreshold was given.  */
+  unsigned int ratemass_given ;	/**< @brief Whether ratemass was given.  */
+  unsigned int coarsegrain_given ;	/**< @brief Whether coarsegrain was given.  */
+  unsigned int clusterthreshold_given ;	/**< @brief Whether clusterthreshold was given.  */
+  unsigned int clustersize_given ;	/**< @brief Whether clustersize was given.  */
+  unsigned int superbasin_given ;	/**< @brief Whether superbasin was given.  */
   unsigned int cutoutenergy_given ;	/**< @brief Whether cutoutenergy was given.  */
   unsigned int cutoutwidth_given ;	/**< @brief Whether cutoutwidth was given.  */
   unsigned int simulation_given ;	/**< @brief Whether simulation was given.  */
   unsigned int relaxation_given ;	/**< @brief Whether relaxation was given.  */
   unsigned int nreruns_given ;	/**< @brief Whether nreruns was given.  */
   unsigned int many_given ;	/**< @brief Whether many was given.  */
+  unsigned int alias_given ;	/**< @brief Whether alias was given.  */
+  unsigned int calendar_given ;	/**< @brief Whether calendar was given.  */
+  unsigned int rejectionfree_given ;	/**< @brief Whether rejectionfree was given.  */
+  unsigned int kernelbench_given ;	/**< @brief Whether kernelbench was given.  */
+  unsigned int fastrng_given ;	/**< @brief Whether fastrng was given.  */
+  unsigned int counterrng_given ;	/**< @brief Whether counterrng was given.  */
+  unsigned int parallelreruns_given ;	/**< @brief Whether parallelreruns was given.  */
+  unsigned int interleave_given ;	/**< @brief Whether interleave was given.  */
   unsigned int be_given ;	/**< @brief Whether be was given.  */
   unsigned int mgmres_given ;	/**< @brief Whether mgmres was given.  */
   unsigned int be_it_given ;	/**< @brief Whether be_it was given.  */
@@ -23,7 +23,7 @@
 #include "hop.h"
 
 void
-average_errors (Results * res)
+average_errors (Results * res, Params * prms)
 {
     Result *results[] = {
         &(res->mobility),
@@ -36,7 +36,9 @@ average_errors (Results * res)
         &(res->nHops),
         &(res->nFailedAttempts),
         &(res->simulationTime),
-        &(res->nSites)
+        &(res->nSites),
+        &(res->discardedRate),
+        &(res->hopsSaved)
     };
 
     int nResults = sizeof (results) / sizeof (Result *);
@@ -47,7 +49,7 @@ average_errors (Results * res)
     for (i = 0; i < nResults; ++i)
     {
         c = 0;
-        for (j = 0; j < prms.number_runs; ++j)
+        for (j = 0; j < prms->number_runs; ++j)
         {
             if (results[i]->done[j])
             {
@@ -64,7 +66,7 @@ average_errors (Results * res)
     for (i = 0; i < nResults; ++i)
     {
         c = 0;
-        for (j = 0; j < prms.number_runs; ++j)
+        for (j = 0; j < prms->number_runs; ++j)
         {
             if (results[i]->done[j])
             {
@@ -81,7 +83,7 @@ average_errors (Results * res)
 }
 
 void
-init_results (Results * res)
+init_results (Results * res, Params * prms)
 {
     Result *results[] = {
         &(res->mobility),
@@ -94,7 +96,9 @@ init_results (Results * res)
         &(res->nHops),
         &(res->nFailedAttempts),
         &(res->simulationTime),
-        &(res->nSites)
+        &(res->nSites),
+        &(res->discardedRate),
+        &(res->hopsSaved)
     };
 
     int nResults = sizeof (results) / sizeof (Result *);
@@ -104,11 +108,11 @@ init_results (Results * res)
     {
         results[i]->avg = 0;
         results[i]->err = 0;
-        results[i]->done = (bool *) malloc (sizeof (bool) * prms.number_runs);
+        results[i]->done = (bool *) malloc (sizeof (bool) * prms->number_runs);
         results[i]->values =
-            (double *) malloc (sizeof (double) * prms.number_runs);
+            (double *) malloc (sizeof (double) * prms->number_runs);
 
-        for (j = 0; j < prms.number_runs; ++j)
+        for (j = 0; j < prms->number_runs; ++j)
         {
             results[i]->values[j] = 0;
             results[i]->done[j] = false;
@@ -133,7 +137,9 @@ free_results (Results * res)
         &(res->nHops),
         &(res->nFailedAttempts),
         &(res->simulationTime),
-        &(res->nSites)
+        &(res->nSites),
+        &(res->discardedRate),
+        &(res->hopsSaved)
     };
 
     int nResults = sizeof (results) / sizeof (Result *);
@@ -148,17 +154,17 @@ free_results (Results * res)
 }
 
 int
-output (int mode, const char *fmt, ...)
+output (Params * prms, int mode, const char *fmt, ...)
 {
     va_list args;
     va_start (args, fmt);
 
-    if (prms.quiet && mode != O_FORCE)
+    if (prms->quiet && mode != O_FORCE)
         return 0;
 
     if ((mode == O_FORCE || mode == O_BOTH) ||
-        (mode == O_PARALLEL && prms.parallel && prms.number_runs > 1) ||
-        (mode == O_SERIAL && (!prms.parallel || prms.number_runs == 1)))
+        (mode == O_PARALLEL && prms->parallel) ||
+        (mode == O_SERIAL && !prms->parallel))
         return vprintf (fmt, args);
 
     return 0;
@@ -22,69 +22,89 @@
 
 #include "hop.h"
 
-// the program parameters
-Params prms;
-
-void printResults (Results * results);
-void printApplicationHeader ();
-void printSettings ();
-void checkApplicationSettings (int argc, char **argv);
-void printEstimatedMemory ();
-
-int
-main (int argc, char **argv)
+/*
+ * Simulates all runs of all configurations of the job file with the
+ * parameters prms, see generateParams(). Nothing but prms is shared, so
+ * several simulations can run in one process. Returns the averaged
+ * results of every point of the sweep for every configuration, see
+ * HOP_freeResults().
+ */
+Results *
+HOP_run (Params * prms)
 {
-    // parse and check command line arguments
-    // and generate the params struct which
-    // is used all over the software
-    generateParams (&prms, argc, argv);
-
-
-    if (prms.memreq)
-    {
-        printEstimatedMemory ();
-        return 0;
-    }
-
-    //output
-    printApplicationHeader ();
-    printSettings ();
-
-    // start simulation
-    int iRun;
-    Results res;
-    init_results (&res);
-
-    // set the number of threads
-    omp_set_num_threads (prms.nthreads);
+    // start simulation, with the results of every point of the sweep for
+    // every configuration of the job file
+    int iTask, nTasks = prms->njobs * prms->number_runs, j, p;
+    Results *res =
+        (Results *) malloc (sizeof (Results) * prms->njobs * prms->npoints);
+    for (j = 0; j < prms->njobs; ++j)
+        for (p = 0; p < prms->npoints; ++p)
+        {
+            Results *r = &res[j * prms->npoints + p];
+            init_results (r, prms);
+            r->temperature = (prms->npoints > 1) ?
+                prms->temperatures[p] : prms->jobs[j].temperature;
+            r->field = (prms->npoints > 1) ?
+                prms->fields[p] : prms->jobs[j].field;
+            r->loclength = prms->jobs[j].loclength;
+            r->ncarriers = prms->jobs[j].ncarriers;
+        }
 
-#pragma omp parallel if(prms.parallel) shared(res) private(iRun)
+    // the runs of all configurations are one pool of tasks, so that the
+    // threads stay busy until the last of them is done
+#pragma omp parallel if(prms->parallel) shared(res, prms) private(iTask) \
+    num_threads(GSL_MIN (prms->nthreads, nTasks))
     {
 #pragma omp for schedule(dynamic)
-        for (iRun = 1; iRun <= prms.number_runs; iRun++)
+        for (iTask = 0; iTask < nTasks; iTask++)
         {
+            int iJob = iTask / prms->number_runs;
+            int iRun = iTask % prms->number_runs + 1;
+            Job *job = &prms->jobs[iJob];
+
             // setup random number generator
-            RunParams runprms;
-            runprms.r = gsl_rng_alloc (prms.T);
+            RunParams runprms = { 0 };
+            runprms.prms = prms;
+            runprms.r = gsl_rng_alloc (prms->T);
+            runprms.basin = -1;
             runprms.rseed_used = time (NULL) * iRun;
-            if (prms.rseed != 0)
-                runprms.rseed_used = (unsigned long) prms.rseed + iRun - 1;
+            if (prms->rseed != 0)
+                runprms.rseed_used = (unsigned long) prms->rseed + iRun - 1;
             gsl_rng_set (runprms.r, runprms.rseed_used);
-            runprms.nHops = 0;
-            runprms.nFailedAttempts = 0;
-            runprms.stat = false;
-            runprms.simulationTime = 0;
+
+            // counter-based streams: the seed is the key, the run is part
+            // of the stream address
+            if (prms->counterrng)
+            {
+                runprms.rseed_used = (prms->rseed != 0) ?
+                    (unsigned long) prms->rseed : (unsigned long) time (NULL);
+                RNG_setStream (runprms.r, runprms.rseed_used, iRun, 0,
+                               RNG_STREAM_SAMPLE);
+            }
             runprms.iRun = iRun;
-            runprms.nSites = prms.nsites;
+            runprms.nSites = prms->nsites;
+            runprms.nthreads = HOP_threads (prms);
+
+            // the configuration of the job file
+            runprms.iJob = iJob;
+            runprms.temperature = job->temperature;
+            runprms.field = job->field;
+            runprms.loclength = job->loclength;
+            runprms.ncarriers = job->ncarriers;
+            if (prms->njobs > 1 && iRun == 1)
+                output (prms, O_SERIAL,
+                        "\nConfiguration %d of %d: \tT = %2.4f, F = %2.4f, a = %2.4f, n = %d\n",
+                        iJob + 1, prms->njobs, job->temperature, job->field,
+                        job->loclength, job->ncarriers);
 
             // here is where el magico happens
-            if (prms.balance_eq)
+            if (prms->balance_eq)
             {
-                BE_run (&res, &runprms);
+                BE_run (&res[iJob * prms->npoints], &runprms);
             }
             else
             {
-                MC_run (&res, &runprms);
+                MC_run (&res[iJob * prms->npoints], &runprms);
             }
 
             // free the RNG
@@ -93,31 +113,51 @@ main (int argc, char **argv)
         }
     }
 
-    // average results (see helper.c)
-    average_errors (&res);
+    for (p = 0; p < prms->njobs * prms->npoints; ++p)
+        average_errors (&res[p], prms);
 
-    // summary
-    if (strArgGiven (prms.output_summary))
-        writeSummary (&res);
+    return res;
+}
 
-    // output results to the command line
-    printResults (&res);
+/*
+ * The number of threads of the parallel regions of one run. The runs are
+ * executed one after the other, or in parallel with --parallel, in which
+ * case the threads left over are split among them. The nested regions of
+ * parallel runs only get these threads when the caller allows nested
+ * parallelism, see main().
+ */
+int
+HOP_threads (Params * prms)
+{
+    int nTasks = prms->njobs * prms->number_runs;
 
-    // free results structs
-    //int i;
-    //for(i = 0; i< sizeof(res)
-    free_results (&res);
+    if (!prms->parallel)
+        return prms->nthreads;
+
+    return GSL_MAX (1, prms->nthreads / nTasks);
+}
+
+/*
+ * Frees the results of HOP_run().
+ */
+void
+HOP_freeResults (Results * res, Params * prms)
+{
+    int p;
 
-    return 0;
+    for (p = 0; p < prms->njobs * prms->npoints; ++p)
+        free_results (&res[p]);
+    free (res);
 }
 
 /*
  * This function prints out a useless header for the program.
  */
 void
-printApplicationHeader ()
+printApplicationHeader (Params * prms)
 {
-    output (O_BOTH, "\n\n################### %s v%s ################### \n",
+    output (prms, O_BOTH,
+            "\n\n################### %s v%s ################### \n",
             PKG_NAME, PKG_VERSION);
 }
 
@@ -125,109 +165,215 @@ printApplicationHeader ()
  * This function just prints out the parameters of the simulation.
  */
 void
-printSettings ()
+printSettings (Params * prms)
 {
     // Settings output
-    output (O_BOTH, "\nSettings:\n");
-    output (O_BOTH, "\t3D sample size: \t\t%d x %d x %d\n",
-            prms.length_x, prms.length_y, prms.length_z);
-    output (O_BOTH, "\tDOS exponent: \t\t\tp = %1.1f\n", prms.exponent);
-    output (O_BOTH, "\tLocalization length of sites: \ta = %2.4f\n",
-            prms.loclength);
-    output (O_BOTH, "\tTemperature: \t\t\tT = %2.4f\n", prms.temperature);
-    output (O_BOTH, "\tField strength: \t\tF = %2.4f\n", prms.field);
-    output (O_BOTH, "\tCut-off radius: \t\tr = %2.4f\n", prms.cutoff_radius);
-
-    output (O_PARALLEL, "\tParallelization: \t\tRunning on %d cores\n",
-            prms.nthreads);
-    output (O_SERIAL, "\tParallelization: \t\tOff\n");
-    output (O_BOTH, "\tRealizations for Averaging: \ti = %d\n",
-            prms.number_runs);
-    output (O_BOTH, "\tMode: \t\t\t\t%s\n\n",
-            prms.balance_eq ? 
-            (prms.mgmres ? "Balance Equations (MGMRES.c)" : "Balance Equations (LIS)") :
-            (prms.many ? "Monte Carlo Many" : "Monte Carlo Meanfield"));
-
-    if (prms.balance_eq)
+    output (prms, O_BOTH, "\nSettings:\n");
+    output (prms, O_BOTH, "\t3D sample size: \t\t%d x %d x %d\n",
+            prms->length_x, prms->length_y, prms->length_z);
+    output (prms, O_BOTH, "\tDOS exponent: \t\t\tp = %1.1f\n", prms->exponent);
+    output (prms, O_BOTH, "\tLocalization length of sites: \ta = %2.4f\n",
+            prms->loclength);
+    if (strArgGiven (prms->cmdlineargs->temperatures_arg))
+        output (prms, O_BOTH, "\tTemperatures (sweep): \t\tT = %s\n",
+                prms->cmdlineargs->temperatures_arg);
+    else
+        output (prms, O_BOTH,
+                "\tTemperature: \t\t\tT = %2.4f\n", prms->temperature);
+    if (strArgGiven (prms->cmdlineargs->fields_arg))
+        output (prms, O_BOTH, "\tField strengths (sweep): \tF = %s\n",
+                prms->cmdlineargs->fields_arg);
+    else
+        output (prms, O_BOTH,
+                "\tField strength: \t\tF = %2.4f\n", prms->field);
+    if (prms->npoints > 1 && prms->redrawenergies)
+        output (prms, O_BOTH,
+                "\tSite energies: \t\t\tRedrawn for every point\n");
+    output (prms, O_BOTH,
+            "\tCut-off radius: \t\tr = %2.4f\n", prms->cutoff_radius);
+    if (prms->ratemass < 1)
+        output (prms, O_BOTH, "\tRate mass of the neighbors: \t%2.4f\n",
+                prms->ratemass);
+
+    if (prms->njobs > 1)
+        output (prms, O_BOTH, "\tJob file: \t\t\t%s (%d configurations)\n",
+                prms->cmdlineargs->jobfile_arg, prms->njobs);
+    output (prms, O_PARALLEL, "\tParallelization: \t\tRunning on %d cores\n",
+            GSL_MIN (prms->nthreads, prms->njobs * prms->number_runs));
+    output (prms, O_SERIAL, "\tParallelization: \t\tOff\n");
+    output (prms, O_BOTH, "\tRealizations for Averaging: \ti = %d\n",
+            prms->number_runs);
+    output (prms, O_BOTH, "\tMode: \t\t\t\t%s\n\n",
+            prms->balance_eq ? 
+            (prms->mgmres ? "Balance Equations (MGMRES.c)" : "Balance Equations (LIS)") :
+            (prms->many ? "Monte Carlo Many" : "Monte Carlo Meanfield"));
+
+    if (prms->balance_eq)
     {
-        output (O_BOTH, "\tMax. nr. of outer iterations: \t%d\n",
-                prms.be_outer_it);
-        output (O_BOTH, "\tMax. nr. of inner iterations: \t%d\n", prms.be_it);
-        output (O_BOTH, "\tRel. convergence tolerance: \t%e\n",
-                prms.be_rel_tol);
-        output (O_BOTH, "\tAbs. convergence tolerance: \t%e\n",
-                prms.be_abs_tol);
+        output (prms, O_BOTH, "\tMax. nr. of outer iterations: \t%d\n",
+                prms->be_outer_it);
+        output (prms, O_BOTH,
+                "\tMax. nr. of inner iterations: \t%d\n", prms->be_it);
+        output (prms, O_BOTH, "\tRel. convergence tolerance: \t%e\n",
+                prms->be_rel_tol);
+        output (prms, O_BOTH, "\tAbs. convergence tolerance: \t%e\n",
+                prms->be_abs_tol);
     }
     else
     {
-        output (O_BOTH, "\tNumber of reruns:\t\tx = %d\n", prms.number_reruns);
-        output (O_BOTH, "\tNumber of carriers: \t\tn = %d\n", prms.ncarriers);
-        output (O_BOTH, "\tHops of relaxation: \t\tR = %lu\n", prms.relaxation);
-        output (O_BOTH, "\tHops of simulation: \t\tI = %lu\n", prms.simulation);
+        output (prms, O_BOTH,
+                "\tNumber of reruns:\t\tx = %d\n", prms->number_reruns);
+        if (prms->parallelreruns)
+            output (prms, O_BOTH,
+                    "\tReruns: \t\t\tParallel walkers (%d interleaved)\n",
+                    prms->interleave);
+        output (prms, O_BOTH,
+                "\tNumber of carriers: \t\tn = %d\n", prms->ncarriers);
+        output (prms, O_BOTH,
+                "\tHops of relaxation: \t\tR = %lu\n", prms->relaxation);
+        output (prms, O_BOTH,
+                "\tHops of simulation: \t\tI = %lu\n", prms->simulation);
+        output (prms, O_BOTH, "\tRandom number generator: \t%s\n",
+                prms->counterrng ? "Philox4x32-10 streams" : "GSL gfsr4");
+        output (prms, O_BOTH, "\tRandom numbers (hopping): \t%s\n",
+                prms->fastrng ? "Buffered xoshiro256++" : "GSL");
+        output (prms, O_BOTH, "\tNeighbor selection: \t\t%s\n",
+                prms->alias ? "Alias tables" : "Linear scan");
+        if (prms->many)
+            output (prms, O_BOTH, "\tEvent queue: \t\t\t%s\n",
+                    prms->calendar ? "Calendar queue" : "4-ary heap");
+        if (prms->many)
+            output (prms, O_BOTH, "\tKinetic Monte Carlo: \t\t%s\n",
+                    prms->rejectionfree ? "Rejection-free" : "With rejections");
+        if (prms->coarsegrain)
+            output (prms, O_BOTH,
+                    "\tClusters: \t\t\tCoarse-grained (threshold %2.4f, max. %d sites)\n",
+                    prms->clusterthreshold, prms->clustersize);
+        if (prms->superbasin > 0)
+            output (prms, O_BOTH,
+                    "\tSuperbasins: \t\t\tAfter %d hops among max. %d sites\n",
+                    prms->superbasin, prms->clustersize);
 
     }
 
-    output (O_PARALLEL, "\n");
+    output (prms, O_PARALLEL, "\n");
 }
 
 /*
  * This function prints out the results of the simulation.
  */
 void
-printResults (Results * results)
+printResults (Results * results, Params * prms)
 {
     // Results output
-    output (O_BOTH, "\nResults:\n");
-    output (O_BOTH, "\tMobility in field-direction: \tu   = %e (+- %e)\n",
+    if (prms->njobs > 1)
+        output (prms, O_BOTH,
+                "\nResults for T = %2.4f, F = %2.4f, a = %2.4f, n = %d:\n",
+                results->temperature, results->field, results->loclength,
+                results->ncarriers);
+    else if (prms->npoints > 1)
+        output (prms, O_BOTH, "\nResults for T = %2.4f, F = %2.4f:\n",
+                results->temperature, results->field);
+    else
+        output (prms, O_BOTH, "\nResults:\n");
+    output (prms, O_BOTH,
+            "\tMobility in field-direction: \tu   = %e (+- %e)\n",
             results->mobility.avg, results->mobility.err);
+    if (prms->ratemass < 1)
+        output (prms, O_BOTH, "\tDiscarded rate mass: \t\teps = %e (+- %e)\n",
+                results->discardedRate.avg, results->discardedRate.err);
 
-    if (prms.balance_eq)
+    if (prms->balance_eq)
     {
-        output (O_BOTH, "\n");
+        output (prms, O_BOTH, "\n");
         return;
     }
 
-    output (O_BOTH, "\tDiffusivity perp. to field:  \tD   = %e (+- %e)\n",
+    output (prms, O_BOTH,
+            "\tDiffusivity perp. to field:  \tD   = %e (+- %e)\n",
             results->diffusivity.avg, results->diffusivity.err);
-    output (O_BOTH, "\tEinstein rel. perp. to field: \tu/D = %e (+- %e) e/o\n",
+    output (prms, O_BOTH,
+            "\tEinstein rel. perp. to field: \tu/D = %e (+- %e) e/o\n",
             results->einsteinrelation.avg, results->einsteinrelation.err);
-    output (O_BOTH, "\tCurrent density (z-dir):  \tj   = %e (+- %e)\n",
+    output (prms, O_BOTH, "\tCurrent density (z-dir):  \tj   = %e (+- %e)\n",
             results->currentDensity.avg, results->currentDensity.err);
-    output (O_BOTH, "\tEquilibration Energy: \t\tE_i = %e\n",
+    output (prms, O_BOTH, "\tEquilibration Energy: \t\tE_i = %e\n",
             results->equilibrationEnergy.avg);
-    output (O_BOTH, "\tSimulated time: \t\tt   = %e\n\n",
+    if (prms->coarsegrain || prms->superbasin > 0)
+        output (prms, O_BOTH,
+                "\tHops saved in clusters: \tN   = %e (+- %e)\n",
+                results->hopsSaved.avg, results->hopsSaved.err);
+    output (prms, O_BOTH, "\tSimulated time: \t\tt   = %e\n\n",
             results->simulationTime.avg);
 
 }
 
 void
-printEstimatedMemory ()
+printEstimatedMemory (Params * prms)
 {
     double mem = 0;
 
-    // sites
-    mem += prms.nsites * sizeof (Site);
-
-    // carriers
-    mem += prms.ncarriers * sizeof (Carrier);
-
-    // neighbor lists
-    mem +=
-        pow (prms.cutoff_radius,
-             3) * 4. / 3. * M_PI * prms.nsites * sizeof (SLE);
-
-    // parallelization
-    if (prms.parallel && prms.number_runs >= omp_get_max_threads ())
+    // sites, their positions and statistics. The implicit lattice doesn't
+    // store the positions.
+    mem += prms->nsites * (sizeof (Site) + 2 * sizeof (float));
+    if (!prms->implicitlattice)
+        mem += prms->nsites * sizeof (Vector);
+    if (strArgGiven (prms->output_folder))
+        mem += prms->nsites * 2 * sizeof (unsigned int);
+
+    // carriers and their event queue
+    mem += prms->ncarriers * sizeof (Carrier);
+    if (prms->many)
+        mem += prms->ncarriers * (sizeof (Event) + sizeof (int) + sizeof (double));
+
+    // neighbor lists and their transition counters
+    if (!prms->implicitlattice)
+        mem +=
+            pow (prms->cutoff_radius,
+                 3) * 4. / 3. * M_PI * prms->nsites * (sizeof (SLE) +
+                                                       sizeof (int)) +
+            prms->nsites * sizeof (long);
+    if (strArgGiven (prms->output_folder) && prms->output_transitions)
+        mem +=
+            pow (prms->cutoff_radius,
+                 3) * 4. / 3. * M_PI * prms->nsites * sizeof (unsigned int);
+
+    // alias tables
+    if (prms->alias)
+        mem +=
+            pow (prms->cutoff_radius,
+                 3) * 4. / 3. * M_PI * prms->nsites * sizeof (AliasEntry);
+
+    // incoming edges of the rejection-free mode, at most one per neighbor
+    if (prms->rejectionfree)
+        mem +=
+            pow (prms->cutoff_radius,
+                 3) * 4. / 3. * M_PI * prms->nsites * sizeof (InEdge) +
+            prms->nsites * (sizeof (int) + sizeof (double));
+
+    // site statistics of the parallel walkers
+    if (prms->parallelreruns)
+        mem += prms->nsites * (2 * sizeof (unsigned int) + sizeof (float))
+            * omp_get_max_threads ();
+
+    // the original order of the sites
+    if (prms->reorder)
+        mem += prms->nsites * sizeof (int);
+
+    // parallelization, over the runs of all configurations
+    if (prms->parallel &&
+        prms->njobs * prms->number_runs >= omp_get_max_threads ())
         mem *= omp_get_max_threads ();
-    else if (prms.parallel)
-        mem *= prms.number_runs;
+    else if (prms->parallel)
+        mem *= prms->njobs * prms->number_runs;
 
     // results
-    mem += (prms.number_runs + 2) * sizeof (Results);
+    mem += (prms->number_runs + 2) * sizeof (Results) * prms->njobs;
 
     // some offset that shouldn't scale with the system...
     mem += 100 * 1024 * 1024;
 
-    output (O_BOTH, "Estimated memory usage: %5.2f MB\n", mem / (1024 * 1024));
+    output (prms, O_BOTH,
+            "Estimated memory usage: %5.2f MB\n", mem / (1024 * 1024));
     return;
 }
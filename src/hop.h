@@ -27,6 +27,8 @@
 #include <stdbool.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 
 #include <sys/time.h>
 #include <sys/types.h>
@@ -52,6 +54,19 @@
 #define O_BOTH     3
 #define O_FORCE    0
 
+// the event queue types
+#define Q_HEAP     0
+#define Q_CALENDAR 1
+
+// one configuration of a job file (--jobfile), see readJobFile()
+typedef struct job
+{
+    float temperature;
+    float field;
+    float loclength;
+    int ncarriers;
+} Job;
+
 typedef struct params
 {
     // all parameters here
@@ -59,18 +74,47 @@ typedef struct params
     int nx, ny, nz;
     int ncarriers;
     bool many;
+    bool alias;
+    bool calendar;
+    bool rejectionfree;
+    bool kernelbench;
+    bool fastrng;
+    bool counterrng;
+    bool parallelreruns;
+    int interleave;
     int nsites;
     float exponent;
     float loclength;
     float cutoff_radius;
+    float dist_unit;
     float field;
     float temperature;
     bool gaussian;
+
+    // the points of a sweep (--temperatures, --fields). Without one, there
+    // is a single point with the temperature and field above.
+    int npoints;
+    float *temperatures;
+    float *fields;
+    bool redrawenergies;
+
+    // the configurations of the job file (--jobfile). Without one, there
+    // is a single configuration with the parameters above.
+    int njobs;
+    Job *jobs;
+
     bool lattice;
+    bool implicitlattice;
+    bool reorder;
     long relaxation;
     long simulation;
     bool removesoftpairs;
     float softpairthreshold;
+    float ratemass;
+    bool coarsegrain;
+    float clusterthreshold;
+    int clustersize;
+    int superbasin;
     int number_runs;
     int number_reruns;
     bool parallel;
@@ -106,24 +150,214 @@ typedef struct params
 
 } Params;
 
+// the event queue of the --many mode. It stores (time, carrier index)
+// pairs, the carriers themselves stay at fixed positions in their array.
+typedef struct event
+{
+    double time;
+    int carrier;
+} Event;
+
+typedef struct event_queue
+{
+    int type;
+    int n;
+    int *pos;
+    double *time;
+
+    // 4-ary heap
+    Event *heap;
+    void *heapMemory;
+
+    // calendar queue
+    int *next;
+    int *bucketHead;
+    int nBuckets;
+    int current;
+    double width;
+    double bucketTop;
+    int nUpdates;
+} EventQueue;
+
+// the streams of the counter-based random numbers. Sites are generated
+// in blocks of RNG_SITE_BLOCK, each with its own stream.
+#define RNG_STREAM_SAMPLE  0
+#define RNG_STREAM_HOPPING 1
+#define RNG_STREAM_SITES   2
+#define RNG_SITE_BLOCK     4096
+
+// the reruns and points of a sweep share 16 bits of the stream address
+// with the position in the stream
+#define RNG_MAX_RERUN      65536
+
+// the block of random numbers that is generated at once, and the number
+// of independent generators that are advanced in parallel
+#define RNG_BLOCK 1024
+#define RNG_LANES 8
+
+// buffered random numbers for the hopping loop (--fastrng), see rng.c
+typedef struct rng_buffer
+{
+    double uniform[RNG_BLOCK];
+    double exponential[RNG_BLOCK];
+    int iUniform;
+    int iExponential;
+    uint64_t state[4][RNG_LANES];
+} RNGBuffer;
+
+struct site_list_element;
+struct site;
+
+typedef struct vector
+{
+    float x, y, z;
+} Vector;
+
+// a transition of another site into a site, see MC_createIncomingEdges()
+typedef struct in_edge
+{
+    struct site *s;
+    double rate;
+} InEdge;
+
+// a cluster of strongly coupled sites, which a carrier passes in one step
+// (--coarsegrain, --superbasin), see mc_clusters.c. Entering at member j, it stays for
+// the mean time time[j] and leaves from member k with the probability
+// exitProb[j * n + k], which is stored cumulatively. occupation[j * n + k]
+// is the expected time at member k, internalHops[j] the expected number
+// of hops inside. offset is the position of a member relative to the
+// first one.
+typedef struct cluster
+{
+    int n;
+    int *members;
+    Vector *offset;
+    double *rateOut;
+    double *time;
+    double *internalHops;
+    double *occupation;
+    double *exitProb;
+} Cluster;
+
+// the number of basins of --superbasin, whose solution is kept
+#define BASIN_CACHE 256
+
+// the statistics of the sites, stored outside of the Site struct so that
+// the hopping loop touches only the data it needs. The visit counters are
+// only allocated when they are written to the output folder, tempOccTime
+// (the time the current carrier arrived) only in the sequential mode.
+typedef struct site_stats
+{
+    unsigned int *visited;
+    unsigned int *visitedUpward;
+    float *totalOccTime;
+    float *tempOccTime;
+
+    // with --transitions, the number of hops along every edge of the
+    // neighbor graph
+    unsigned int *transitions;
+} SiteStats;
+
 // this struct is instantiated for each run of the simulation, also in
 // parallel mode. This is done so that the RNG for example is not shared
 // between runs. 
 typedef struct run_params
 {
+    // the parameters of the simulation, which several simulations in one
+    // process don't share, see HOP_run()
+    Params *prms;
+
     gsl_rng *r;
+    RNGBuffer *rng;
+    EventQueue *queue;
     long rseed_used;
 
+    // the sites, which the neighbor lists refer to by index
+    struct site *sites;
+
+    // the neighbor graph. The neighbors of site i are edges[k] for
+    // edgeOffset[i] <= k < edgeOffset[i + 1], their alias tables are
+    // stored in the same way.
+    long *edgeOffset;
+    struct site_list_element *edges;
+    struct alias_entry *aliasEntries;
+
+    // the reverse of edges[k], i.e., the hop back, is the neighbor at
+    // position reverse[k] of its destination, see SLE_reverse()
+    int *reverse;
+
+    // the fraction of the total rate, which MC_truncateNeighbors() has
+    // discarded, and the largest fraction of a single site
+    double discardedRate;
+    double discardedRateMax;
+
+    // with --reorder, the original index of the site at each position
+    int *siteOrder;
+
+    // with --implicitlattice, the neighbor offsets that replace the
+    // neighbor graph, see MC_createStencil()
+    struct stencil_entry *stencil;
+    int nStencil;
+
+    // the positions of the sites, which are only needed for the setup and
+    // the output, and their statistics
+    Vector *positions;
+    SiteStats stats;
+
+    // rejection-free mode: the transitions into site i are inEdges[k] for
+    // inOffset[i] <= k < inOffset[i + 1], rateSumWeak[i] is the total rate
+    // of its weak neighbors
+    int *inOffset;
+    InEdge *inEdges;
+    double *rateSumWeak;
+
+    // with --coarsegrain, the clusters and the cluster of every site or
+    // -1. nHopsSaved counts the hops inside the clusters, which were not
+    // simulated.
+    Cluster *clusters;
+    int nClusters;
+    int *clusterOf;
+    double nHopsSaved;
+
+    // with --superbasin, the sites the carrier visited recently and the
+    // number of hops since the first of them. The basins are the
+    // BASIN_CACHE clusters after the static ones, basin is the one the
+    // carrier is passing or -1, see MC_visitBasin().
+    int *basinSites;
+    int nBasinSites;
+    long nBasinHops;
+    int basin;
+
+    // the configuration of the job file and the index, temperature and
+    // field of the current point of the sweep, see MC_setPoint()
+    int iJob;
+    int iPoint;
+    float temperature;
+    float field;
+    float loclength;
+    int ncarriers;
+
     double simulationTime;
     long nHops;
     long nFailedAttempts;
+    double nFailedExpected;
     int nSites;
     int iRun;
     bool stat;
+
+    // the number of threads of the parallel regions of the run, see
+    // HOP_threads()
+    int nthreads;
 } RunParams;
 
-struct site_list_element;
-struct site;
+// one entry of the Walker alias table of a site. The table has one
+// entry per neighbor and allows selecting the destination of a hop
+// with one random number, independent of the number of neighbors.
+typedef struct alias_entry
+{
+    float prob;
+    int alias;
+} AliasEntry;
 
 typedef struct carrier
 {
@@ -131,25 +365,28 @@ typedef struct carrier
     struct site *site;
     int index;
     double occTime;
+
+    // rejection-free mode: the sum of the rates to unoccupied neighbors
+    // and the time it last changed
+    double rateSumFree;
+    double lastChange;
     long nFailedAttempts;
     long nHops;
 } Carrier;
 
 typedef struct site
 {
-    float energy;
-    float x;
-    float y;
-    float z;
-    unsigned long visited;
-    unsigned long visitedUpward;
-    Carrier *carrier;
-    int index;
     struct site_list_element *neighbors;
-    int nNeighbors;
+    Carrier *carrier;
+    AliasEntry *aliasTable;
     double rateSum;
-    float totalOccTime;
-    float tempOccTime;
+    float energy;
+    int nNeighbors;
+    int index;
+
+    // rejection-free mode: the first nStrong neighbors are tracked exactly,
+    // the rest are always attempted
+    int nStrong;
 } Site;
 
 typedef struct result
@@ -173,56 +410,184 @@ typedef struct results_struct
     Result simulationTime;
     Result nFailedAttempts;
     Result nSites;
+    Result discardedRate;
+    Result hopsSaved;
+
+    // the configuration and point of the sweep
+    float temperature;
+    float field;
+    float loclength;
+    int ncarriers;
 
     time_t time_start;
     time_t time_finished;
 } Results;
 
 
-typedef struct vector
-{
-    float x, y, z;
-} Vector;
-
+// one neighbor of a site, 16 bytes. The displacement is stored in
+// multiples of dist_unit, see SLE_dist().
 typedef struct site_list_element
 {
-    Site *s;
-    double rate;
-    Vector dist;
-    int nTransitions;
+    int s;
+    float rate;
+    short dist[3];
 } SLE;
 
-extern Params prms;
+// one neighbor offset of the implicit lattice (--implicitlattice) and its
+// spatial factor exp(-2 d / a). dist is the offset in the units of SLE.
+typedef struct stencil_entry
+{
+    double spatial;
+    int dx, dy, dz;
+    short dist[3];
+} StencilEntry;
+
+// a specialized hopping loop, see mc_hopping.c
+typedef void (*HopKernel) (Carrier * carriers, RunParams * runprms,
+                           long nHops);
+
+// the simulation, see hop.c
+Results *HOP_run (Params * prms);
+int HOP_threads (Params * prms);
+void HOP_freeResults (Results * res, Params * prms);
+void printApplicationHeader (Params * prms);
+void printSettings (Params * prms);
+void printResults (Results * results, Params * prms);
+void printEstimatedMemory (Params * prms);
 
 // helpers
-void average_errors (Results * res);
+void average_errors (Results * res, Params * prms);
 void free_results (Results * res);
-void init_results (Results * res);
-int output (int mode, const char *fmt, ...);
+void init_results (Results * res, Params * prms);
+int output (Params * prms, int mode, const char *fmt, ...);
 
 // output.c
 void writeSites (Site * sites, RunParams * runprms);
 void writeTransitions (Site * sites, RunParams * runprms);
 void writeConfig (RunParams * runprms);
 void writeResults (Results * res, RunParams * runprms);
-void writeSummary (Results * res);
+void writeSummary (Results * res, Params * prms);
 
 // params
 bool strArgGiven (char *arg);
 void generateParams (Params * prms, int argc, char **argv);
+void freeParams (Params * prms);
 
 //mc
-void MC_simulation (Site * sites, Carrier * carriers, RunParams * runprms,
-                    int iReRun);
+void MC_simulation (Carrier * carriers, RunParams * runprms, int iReRun);
 Site *MC_createSites (RunParams * runprms);
 void MC_distributeCarriers (Carrier * carriers, Site * sites,
                             RunParams * runprms);
-Carrier *MC_createCarriers ();
+Carrier *MC_createCarriers (RunParams * runprms);
+void MC_reorderSites (Site * sites, RunParams * runprms);
+void MC_setPoint (Site * sites, RunParams * runprms, int p);
+void MC_redrawEnergies (Site * sites, RunParams * runprms, int p);
 void MC_createHoppingRates (Site * sites, RunParams * runprms);
+void MC_updateHoppingRates (Site * sites, RunParams * runprms);
+void MC_createStencil (Site * sites, RunParams * runprms);
+SLE *MC_latticeNeighbor (Site * s, double randomHopProb, RunParams * runprms,
+                         SLE * e);
 void MC_removeSoftPairs (Site * sites, RunParams * runprms);
+void MC_truncateNeighbors (Site * sites, RunParams * runprms);
+void MC_createAliasTables (Site * sites, RunParams * runprms);
+void MC_createIncomingEdges (Site * sites, RunParams * runprms);
+void MC_createSiteStats (RunParams * runprms);
 void MC_calculateResults (Site * sites, Carrier * carriers, Results * res,
                           RunParams * runprms);
 void MC_run (Results * total, RunParams * runprms);
+void MC_runWalkers (Site * sites, Carrier * carriers, RunParams * runprms);
+double MC_freeRateSum (Site * s, RunParams * runprms);
+void MC_createClusters (Site * sites, RunParams * runprms);
+void MC_freeClusters (RunParams * runprms);
+double MC_clusterTime (Site * s, RunParams * runprms);
+SLE *MC_clusterExit (Site * s, RunParams * runprms);
+void MC_clusterLeave (Site * s, SLE * dest, Vector * dist,
+                      RunParams * runprms);
+void MC_visitBasin (Site * s, RunParams * runprms);
+void MC_resetBasin (RunParams * runprms);
+
+// random numbers
+RNGBuffer *RNG_create (gsl_rng * r);
+void RNG_free (RNGBuffer * b);
+void RNG_seed (RNGBuffer * b, gsl_rng * r);
+void RNG_setStream (gsl_rng * r, unsigned long seed, int run, int rerun,
+                    int stream);
+extern const gsl_rng_type *RNG_philox;
+void RNG_refillUniform (RNGBuffer * b);
+void RNG_refillExponential (RNGBuffer * b);
+
+/*
+ * A uniform random number in [0,1) for the hopping loop. It is read from
+ * the buffer, if --fastrng is set, otherwise from the GSL generator.
+ */
+static inline double
+RNG_uniform (RunParams * runprms)
+{
+    RNGBuffer *b = runprms->rng;
+
+    if (b == NULL)
+        return gsl_rng_uniform (runprms->r);
+
+    if (b->iUniform == RNG_BLOCK)
+        RNG_refillUniform (b);
+
+    return b->uniform[b->iUniform++];
+}
+
+/*
+ * An exponentially distributed random number with mean one.
+ */
+static inline double
+RNG_exponential (RunParams * runprms)
+{
+    RNGBuffer *b = runprms->rng;
+
+    if (b == NULL)
+        return gsl_ran_exponential (runprms->r, 1.0);
+
+    if (b->iExponential == RNG_BLOCK)
+        RNG_refillExponential (b);
+
+    return b->exponential[b->iExponential++];
+}
+
+/*
+ * The displacement of a hop along the neighbor list entry e. It is stored
+ * in multiples of dist_unit, the smallest power of two for which
+ * the cut-off radius fits into 16 bit. Every component is accurate to
+ * dist_unit / 2 (6.1e-5 for --rc 3, where dist_unit = 2^-13), lattice
+ * vectors are exact.
+ */
+static inline Vector
+SLE_dist (const SLE * e, const RunParams * runprms)
+{
+    Vector v;
+    float unit = runprms->prms->dist_unit;
+
+    v.x = e->dist[0] * unit;
+    v.y = e->dist[1] * unit;
+    v.z = e->dist[2] * unit;
+
+    return v;
+}
+
+/*
+ * The reverse of the neighbor list entry e, i.e., the hop back from its
+ * destination.
+ */
+static inline SLE *
+SLE_reverse (const SLE * e, const RunParams * runprms)
+{
+    return &runprms->edges[runprms->edgeOffset[e->s] +
+                           runprms->reverse[e - runprms->edges]];
+}
+
+// event queue
+EventQueue *EQ_create (int n, int type);
+void EQ_free (EventQueue * q);
+void EQ_build (EventQueue * q, Carrier * carriers);
+int EQ_top (EventQueue * q);
+void EQ_update (EventQueue * q, int c, double time);
 
 int timeval_subtract (struct timeval *result,
                       struct timeval *x, struct timeval *y);
@@ -231,6 +596,6 @@ int timeval_subtract (struct timeval *result,
 void BE_run (Results * res, RunParams * runprms);
 
 // analytics
-double calcFermiEnergy ();
+double calcFermiEnergy (RunParams * runprms);
 
 #endif /* HOP_H */
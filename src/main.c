@@ -0,0 +1,71 @@
+/*
+ * hophop: Charge transport simulations in disordered systems
+ *
+ * Copyright (c) 2012-2018 Jan Oliver Oelerich <jan.oliver.oelerich@physik.uni-marburg.de>
+ * Copyright (c) 2012-2018 Disordered Many-Particle Physics Group, Philipps-Universität Marburg, Germany
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+*/
+
+
+#include "hop.h"
+
+int
+main (int argc, char **argv)
+{
+    // parse and check command line arguments
+    // and generate the params struct which
+    // is used all over the software
+    Params prms;
+    generateParams (&prms, argc, argv);
+
+
+    if (prms.memreq)
+    {
+        printEstimatedMemory (&prms);
+        freeParams (&prms);
+        return 0;
+    }
+
+    //output
+    printApplicationHeader (&prms);
+    printSettings (&prms);
+
+    // the threads left idle by fewer parallel runs than threads are shared
+    // among the runs in nested regions, see HOP_threads()
+    if (prms.parallel &&
+        prms.njobs * prms.number_runs < prms.nthreads)
+        omp_set_max_active_levels (2);
+
+    // start simulation
+    Results *res = HOP_run (&prms);
+
+    int p;
+    for (p = 0; p < prms.njobs * prms.npoints; ++p)
+    {
+        // summary
+        if (strArgGiven (prms.output_summary))
+            writeSummary (&res[p], &prms);
+
+        // output results to the command line
+        printResults (&res[p], &prms);
+    }
+
+    // free results structs
+    HOP_freeResults (res, &prms);
+    freeParams (&prms);
+
+    return 0;
+}
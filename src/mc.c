@@ -22,35 +22,127 @@
 
 #include "hop.h"
 
+void simulate (Site * sites, Results * res, RunParams * runprms);
+
+/*
+ * One run: a realization of the sample, which is simulated at every point
+ * of the sweep (--temperatures, --fields). res has one entry per point.
+ */
 void
 MC_run (Results * res, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     Site *sites = NULL;
+    int p;
+
+    // some output
+    output (prms, O_PARALLEL,
+            "Starting %d. Iteration (total %d): Thread ID %d\n",
+            runprms->iRun, prms->number_runs, omp_get_thread_num ());
+    output (prms, O_SERIAL,
+            "\nRunning %d. iteration (total %d):\n", runprms->iRun,
+            prms->number_runs);
+
+    // create the sites, the neighbors are searched only for the first
+    // point
+    sites = MC_createSites (runprms);
+    for (p = 0; p < prms->npoints; ++p)
+    {
+        if (prms->npoints > 1)
+            output (prms, O_SERIAL,
+                    "\tPoint %d of %d: \t\tT = %2.4f, F = %2.4f\n",
+                    p + 1, prms->npoints, prms->temperatures[p],
+                    prms->fields[p]);
+
+        MC_setPoint (sites, runprms, p);
+        simulate (sites, &res[p], runprms);
+    }
+
+    // free resources
+    free (runprms->edgeOffset);
+    free (runprms->edges);
+    free (runprms->aliasEntries);
+    free (runprms->reverse);
+    runprms->edgeOffset = NULL;
+    runprms->edges = NULL;
+    runprms->aliasEntries = NULL;
+    runprms->reverse = NULL;
+    free (runprms->stencil);
+    runprms->stencil = NULL;
+    free (sites);
+    free (runprms->siteOrder);
+    runprms->siteOrder = NULL;
+    runprms->sites = NULL;
+    free (runprms->positions);
+    runprms->positions = NULL;
+    free (runprms->inOffset);
+    free (runprms->inEdges);
+    free (runprms->rateSumWeak);
+    runprms->inOffset = NULL;
+    runprms->inEdges = NULL;
+    runprms->rateSumWeak = NULL;
+    MC_freeClusters (runprms);
+
+    return;
+}
+
+/*
+ * Simulates the carriers in the sample with the current rates, and
+ * stores the results in res.
+ */
+void
+simulate (Site * sites, Results * res, RunParams * runprms)
+{
+    Params *prms = runprms->prms;
     Carrier *carriers = NULL;
     int i;
 
     struct timeval start, end, result;
 
-    // some output
-    output (O_PARALLEL, "Starting %d. Iteration (total %d): Thread ID %d\n",
-            runprms->iRun, prms.number_runs, omp_get_thread_num ());
-    output (O_SERIAL, "\nRunning %d. iteration (total %d):\n", runprms->iRun,
-            prms.number_runs);
+    runprms->simulationTime = 0;
+    runprms->nHops = 0;
+    runprms->nFailedAttempts = 0;
+    runprms->nFailedExpected = 0.0;
+    runprms->nHopsSaved = 0.0;
 
-    // create the sites, cells, carriers, hopping rates
-    sites = MC_createSites (runprms);
-    MC_createHoppingRates (sites, runprms);
-    if (prms.removesoftpairs)
-        MC_removeSoftPairs (sites, runprms);
-    carriers = MC_createCarriers ();
+    // the carriers and everything that depends on the rates
+    if (prms->alias)
+        MC_createAliasTables (sites, runprms);
+    if (prms->rejectionfree)
+        MC_createIncomingEdges (sites, runprms);
+    MC_createSiteStats (runprms);
+    carriers = MC_createCarriers (runprms);
+    if (prms->fastrng)
+        runprms->rng = RNG_create (runprms->r);
+    if (prms->many)
+        runprms->queue =
+            EQ_create (runprms->ncarriers, prms->calendar ? Q_CALENDAR : Q_HEAP);
 
     gettimeofday (&start, NULL);
 
     // simulate
-    for (i = 0; i < prms.number_reruns; ++i)
+    if (prms->parallelreruns)
+    {
+        MC_runWalkers (sites, carriers, runprms);
+    }
+    else
     {
-        MC_distributeCarriers (carriers, sites, runprms);
-        MC_simulation (sites, carriers, runprms, i + 1);
+        for (i = 0; i < prms->number_reruns; ++i)
+        {
+            // every rerun of every point of a sweep has its own stream
+            if (prms->counterrng)
+            {
+                RNG_setStream (runprms->r, runprms->rseed_used,
+                               runprms->iRun,
+                               runprms->iPoint * prms->number_reruns + i + 1,
+                               RNG_STREAM_HOPPING);
+                if (runprms->rng != NULL)
+                    RNG_seed (runprms->rng, runprms->r);
+            }
+
+            MC_distributeCarriers (carriers, sites, runprms);
+            MC_simulation (carriers, runprms, i + 1);
+        }
     }
 
     // some more output
@@ -59,36 +151,38 @@ MC_run (Results * res, RunParams * runprms)
 
     double elapsed = result.tv_sec + (double) result.tv_usec / 1e6;
 
-    output (O_PARALLEL,
+    output (prms, O_PARALLEL,
             "Finished %d. Iteration (total %d): %lu successful hops/sec (%ld failed)\n",
-            runprms->iRun, prms.number_runs,
-            (size_t) (prms.number_reruns * (prms.relaxation + prms.simulation) /
+            runprms->iRun, prms->number_runs,
+            (size_t) (prms->number_reruns * (prms->relaxation + prms->simulation) /
                       elapsed), runprms->nFailedAttempts);
-    output (O_SERIAL, " Done. %lu successful hops/sec (%ld failed)\n",
-            (size_t) (prms.number_reruns * (prms.relaxation + prms.simulation) /
+    output (prms, O_SERIAL, " Done. %lu successful hops/sec (%ld failed)\n",
+            (size_t) (prms->number_reruns * (prms->relaxation + prms->simulation) /
                       elapsed), runprms->nFailedAttempts);
 
     // calculate the results
     MC_calculateResults (sites, carriers, res, runprms);
 
     // write output files
-    if (strArgGiven (prms.output_folder))
+    if (strArgGiven (prms->output_folder))
     {
         writeResults (res, runprms);
         writeConfig (runprms);
         writeSites (sites, runprms);
-        if (prms.output_transitions)
+        if (prms->output_transitions)
             writeTransitions (sites, runprms);
     }
 
     // free resources
-    for (i = 0; i < runprms->nSites; ++i)
-    {
-        // free neighbor memory
-        free (sites[i].neighbors);
-    }
-    free (sites);
     free (carriers);
-
-    return;
+    free (runprms->stats.visited);
+    free (runprms->stats.visitedUpward);
+    free (runprms->stats.totalOccTime);
+    free (runprms->stats.tempOccTime);
+    free (runprms->stats.transitions);
+    runprms->stats = (SiteStats) { NULL };
+    EQ_free (runprms->queue);
+    runprms->queue = NULL;
+    RNG_free (runprms->rng);
+    runprms->rng = NULL;
 }
@@ -23,22 +23,24 @@
 #include "hop.h"
 
 double calcMobility (Carrier * carriers, RunParams * runprms);
-double calcDiffusivity (Carrier * carriers);
+double calcDiffusivity (Carrier * carriers, RunParams * runprms);
 double calcEinsteinRelation (Carrier * carriers, RunParams * runprms);
 double calcCurrentDensity (Carrier * carriers, RunParams * runprms);
 double calcEquilibrationEnergy (Site * sites, RunParams * runprms);
-double calcAverageEnergy (Carrier * carriers);
+double calcAverageEnergy (Carrier * carriers, RunParams * runprms);
 
 void
 MC_calculateResults (Site * sites, Carrier * carriers, Results * res,
                      RunParams * runprms)
 {
+    Params *prms = runprms->prms;
+
     // calculate results
     res->mobility.values[runprms->iRun - 1] = calcMobility (carriers, runprms);
     res->mobility.done[runprms->iRun - 1] = true;
 
     res->diffusivity.values[runprms->iRun - 1] =
-        calcDiffusivity (carriers);
+        calcDiffusivity (carriers, runprms);
     res->diffusivity.done[runprms->iRun - 1] = true;
 
     res->currentDensity.values[runprms->iRun - 1] =
@@ -49,7 +51,8 @@ MC_calculateResults (Site * sites, Carrier * carriers, Results * res,
         calcEquilibrationEnergy (sites, runprms);
     res->equilibrationEnergy.done[runprms->iRun - 1] = true;
 
-    res->avgenergy.values[runprms->iRun - 1] = calcAverageEnergy (carriers);
+    res->avgenergy.values[runprms->iRun - 1] =
+        calcAverageEnergy (carriers, runprms);
     res->avgenergy.done[runprms->iRun - 1] = true;
 
     res->einsteinrelation.values[runprms->iRun - 1] =
@@ -68,6 +71,14 @@ MC_calculateResults (Site * sites, Carrier * carriers, Results * res,
     res->nSites.values[runprms->iRun - 1] = (float) runprms->nSites;
     res->nSites.done[runprms->iRun - 1] = true;
 
+    res->discardedRate.values[runprms->iRun - 1] = runprms->discardedRate;
+    res->discardedRate.done[runprms->iRun - 1] = true;
+
+    // the hops inside the clusters of --coarsegrain, per rerun
+    res->hopsSaved.values[runprms->iRun - 1] =
+        runprms->nHopsSaved / prms->number_reruns;
+    res->hopsSaved.done[runprms->iRun - 1] = true;
+
 }
 
 /*
@@ -79,17 +90,18 @@ MC_calculateResults (Site * sites, Carrier * carriers, Results * res,
 double
 calcMobility (Carrier * carriers, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     int i;
     double ez = 0;
 
     // the meanfield stuff
     int ncarriers = 1;
-    if (prms.many)
-        ncarriers = prms.ncarriers;
+    if (prms->many)
+        ncarriers = runprms->ncarriers;
 
     for (i = 0; i < ncarriers; ++i)
         ez += carriers[i].dz;
-    return ez / (ncarriers * prms.field * runprms->simulationTime);
+    return ez / (ncarriers * runprms->field * runprms->simulationTime);
 }
 
 /*
@@ -99,16 +111,17 @@ calcMobility (Carrier * carriers, RunParams * runprms)
 double
 calcEquilibrationEnergy (Site * sites, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     long i;
     double sum = 0;
 
     // the meanfield stuff
     int ncarriers = 1;
-    if (prms.many)
-        ncarriers = prms.ncarriers;
+    if (prms->many)
+        ncarriers = runprms->ncarriers;
 
     for (i = 0; i < runprms->nSites; ++i)
-        sum += sites[i].totalOccTime * sites[i].energy;
+        sum += runprms->stats.totalOccTime[i] * sites[i].energy;
 
     return sum / (ncarriers * runprms->simulationTime);
 }
@@ -118,8 +131,9 @@ calcEquilibrationEnergy (Site * sites, RunParams * runprms)
  * perpendicular to the field direction.
  */
 double
-calcDiffusivity (Carrier * carriers)
+calcDiffusivity (Carrier * carriers, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     double ex2, ey2;
     int i;
     ex2 = 0.0;
@@ -127,8 +141,8 @@ calcDiffusivity (Carrier * carriers)
 
     // the meanfield stuff
     int ncarriers = 1;
-    if (prms.many)
-        ncarriers = prms.ncarriers;
+    if (prms->many)
+        ncarriers = runprms->ncarriers;
 
     for (i = 0; i < ncarriers; ++i)
     {
@@ -147,6 +161,7 @@ calcDiffusivity (Carrier * carriers)
 double
 calcEinsteinRelation (Carrier * carriers, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     double ex2, ey2, ez;
     int i;
     ez = 0.0;
@@ -155,8 +170,8 @@ calcEinsteinRelation (Carrier * carriers, RunParams * runprms)
 
     // the meanfield stuff
     int ncarriers = 1;
-    if (prms.many)
-        ncarriers = prms.ncarriers;
+    if (prms->many)
+        ncarriers = runprms->ncarriers;
 
     for (i = 0; i < ncarriers; ++i)
     {
@@ -165,7 +180,7 @@ calcEinsteinRelation (Carrier * carriers, RunParams * runprms)
         ez += carriers[i].dz;
     }
 
-    return (4. * ez) / (runprms->simulationTime * prms.field * (ex2 + ey2));
+    return (4. * ez) / (runprms->simulationTime * runprms->field * (ex2 + ey2));
 
 }
 
@@ -175,13 +190,14 @@ calcEinsteinRelation (Carrier * carriers, RunParams * runprms)
 double
 calcCurrentDensity (Carrier * carriers, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     int i;
     double ez = 0;
 
     // the meanfield stuff
     int ncarriers = 1;
-    if (prms.many)
-        ncarriers = prms.ncarriers;
+    if (prms->many)
+        ncarriers = runprms->ncarriers;
 
     for (i = 0; i < ncarriers; ++i)
         ez += carriers[i].dz;
@@ -193,15 +209,16 @@ calcCurrentDensity (Carrier * carriers, RunParams * runprms)
  * is calculated here. 
  */
 double
-calcAverageEnergy (Carrier * carriers)
+calcAverageEnergy (Carrier * carriers, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     int i;
     double avg = 0;
 
     // the meanfield stuff
     int ncarriers = 1;
-    if (prms.many)
-        ncarriers = prms.ncarriers;
+    if (prms->many)
+        ncarriers = runprms->ncarriers;
 
     for (i = 0; i < ncarriers; ++i)
         avg += carriers[i].site->energy;
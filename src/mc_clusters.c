@@ -0,0 +1,541 @@
+/*
+ * hophop: Charge transport simulations in disordered systems
+ *
+ * Copyright (c) 2012-2018 Jan Oliver Oelerich <jan.oliver.oelerich@physik.uni-marburg.de>
+ * Copyright (c) 2012-2018 Disordered Many-Particle Physics Group, Philipps-Universität Marburg, Germany
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+*/
+
+
+
+
+#include "hop.h"
+
+int findRoot (int *parent, int i);
+int clusterMember (Cluster * cl, int s);
+bool solveCluster (Cluster * cl, int id, Site * sites, RunParams * runprms);
+void freeCluster (Cluster * cl);
+void enterBasin (RunParams * runprms);
+void insertionSortInt (int *a, int n);
+
+/*
+ * Finds the clusters of strongly coupled sites for --coarsegrain. An edge
+ * is strong, if it carries more than prms->clusterthreshold of the rate of
+ * its site. The clusters are the connected components of the strong edges
+ * with 2 to prms->clustersize sites. A carrier, which enters one of them,
+ * would rattle between its sites for many hops before it leaves. Instead,
+ * it passes the cluster in one step, with the exit times and exit sites
+ * of the local master equation, see solveCluster(). The clusters of an
+ * earlier point of a sweep are replaced. With --superbasin, the clusters
+ * after them hold the basins of MC_visitBasin().
+ */
+void
+MC_createClusters (Site * sites, RunParams * runprms)
+{
+    Params *prms = runprms->prms;
+    int i, k, a, b, id, nSites = 0, *parent, *size;
+    long e;
+    double hops = 0.0;
+    Cluster *cl;
+
+    MC_freeClusters (runprms);
+
+    parent = (int *) malloc (sizeof (int) * runprms->nSites);
+    size = (int *) calloc (runprms->nSites, sizeof (int));
+    for (i = 0; i < runprms->nSites; ++i)
+        parent[i] = i;
+
+    // the connected components of the strong edges, their root is the
+    // site with the lowest index
+    for (i = 0; prms->coarsegrain && i < runprms->nSites; ++i)
+    {
+        for (k = 0; k < sites[i].nNeighbors; ++k)
+        {
+            e = runprms->edgeOffset[i] + k;
+            if (runprms->edges[e].rate <=
+                prms->clusterthreshold * sites[i].rateSum)
+                continue;
+
+            a = findRoot (parent, i);
+            b = findRoot (parent, runprms->edges[e].s);
+            if (a != b)
+                parent[GSL_MAX (a, b)] = GSL_MIN (a, b);
+        }
+    }
+    for (i = 0; i < runprms->nSites; ++i)
+        size[findRoot (parent, i)]++;
+
+    // number the clusters in the order of their roots
+    runprms->clusterOf = (int *) malloc (sizeof (int) * runprms->nSites);
+    for (i = 0; i < runprms->nSites; ++i)
+    {
+        runprms->clusterOf[i] = -1;
+        if (parent[i] == i && size[i] > 1 && size[i] <= prms->clustersize)
+            runprms->clusterOf[i] = runprms->nClusters++;
+    }
+
+    runprms->clusters = (Cluster *) calloc (runprms->nClusters + BASIN_CACHE,
+                                            sizeof (Cluster));
+    runprms->basinSites = (int *) malloc (sizeof (int) * prms->clustersize);
+    runprms->nBasinSites = 0;
+    runprms->nBasinHops = 0;
+    runprms->basin = -1;
+    for (i = 0; i < runprms->nSites; ++i)
+    {
+        a = findRoot (parent, i);
+        id = runprms->clusterOf[a];
+        runprms->clusterOf[i] = id;
+        if (id < 0)
+            continue;
+
+        cl = &runprms->clusters[id];
+        if (cl->members == NULL)
+            cl->members = (int *) malloc (sizeof (int) * size[a]);
+        cl->members[cl->n++] = i;
+    }
+    free (parent);
+    free (size);
+
+    // the clusters, which no carrier can leave, are passed hop by hop
+#pragma omp parallel for private(k) schedule(dynamic, 16) \
+    num_threads(runprms->nthreads)
+    for (id = 0; id < runprms->nClusters; ++id)
+    {
+        if (solveCluster (&runprms->clusters[id], id, sites, runprms))
+            continue;
+
+        for (k = 0; k < runprms->clusters[id].n; ++k)
+            runprms->clusterOf[runprms->clusters[id].members[k]] = -1;
+        runprms->clusters[id].n = 0;
+    }
+
+    for (id = 0, k = 0; id < runprms->nClusters; ++id)
+    {
+        cl = &runprms->clusters[id];
+        for (i = 0; i < cl->n; ++i)
+            hops += cl->internalHops[i];
+        nSites += cl->n;
+        k += (cl->n > 0) ? 1 : 0;
+    }
+
+    if (prms->coarsegrain)
+        output (prms, O_SERIAL,
+                "\tCoarse-graining...: \t\tDone. %d clusters with %d sites, "
+                "%e hops inside per passage.\n", k, nSites,
+                (nSites > 0) ? hops / nSites : 0.0);
+}
+
+/*
+ * Frees the clusters of MC_createClusters().
+ */
+void
+MC_freeClusters (RunParams * runprms)
+{
+    int i;
+
+    if (runprms->clusters == NULL)
+        return;
+
+    for (i = 0; i < runprms->nClusters + BASIN_CACHE; ++i)
+    {
+        free (runprms->clusters[i].members);
+        freeCluster (&runprms->clusters[i]);
+    }
+    free (runprms->clusters);
+    free (runprms->clusterOf);
+    free (runprms->basinSites);
+    runprms->clusters = NULL;
+    runprms->clusterOf = NULL;
+    runprms->basinSites = NULL;
+    runprms->nClusters = 0;
+}
+
+/*
+ * Frees the solution of the local master equation of cl.
+ */
+void
+freeCluster (Cluster * cl)
+{
+    free (cl->offset);
+    free (cl->rateOut);
+    cl->offset = NULL;
+    cl->rateOut = NULL;
+    cl->time = NULL;
+    cl->internalHops = NULL;
+    cl->occupation = NULL;
+    cl->exitProb = NULL;
+}
+
+/*
+ * The root of the component of site i, with path halving.
+ */
+int
+findRoot (int *parent, int i)
+{
+    while (parent[i] != i)
+    {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+/*
+ * The position of site s in the cluster cl.
+ */
+int
+clusterMember (Cluster * cl, int s)
+{
+    int k;
+
+    for (k = 0; k < cl->n; ++k)
+        if (cl->members[k] == s)
+            return k;
+    return -1;
+}
+
+/*
+ * Solves the local master equation of the cluster cl. With the carrier
+ * inside, it is an absorbing Markov chain: A = diag(R) - W, where W are
+ * the rates between the members and R their total rates, contains the
+ * expected times at member k after entering at member j, N = A^-1. A is
+ * an M-matrix, so its LU decomposition needs no pivoting. The diagonal of
+ * every step is calculated from the rates out of the cluster, which
+ * avoids the cancellation for the slow exits of deep clusters (the GTH
+ * algorithm). Returns false, if the carrier cannot leave the cluster.
+ */
+bool
+solveCluster (Cluster * cl, int id, Site * sites, RunParams * runprms)
+{
+    int n = cl->n, i, j, k, p, *queue;
+    double *A, *out, *rateIn, *x, sum;
+    bool *done;
+    SLE *e;
+
+    // the solution is stored in one block, which starts at rateOut
+    A = (double *) calloc (n * n + 3 * n, sizeof (double));
+    out = A + n * n;
+    rateIn = out + n;
+    x = rateIn + n;
+    cl->offset = (Vector *) calloc (n, sizeof (Vector));
+    cl->rateOut = (double *) calloc (2 * n * n + 3 * n, sizeof (double));
+    cl->time = cl->rateOut + n;
+    cl->internalHops = cl->time + n;
+    cl->occupation = cl->internalHops + n;
+    cl->exitProb = cl->occupation + n * n;
+
+    // the rates inside and out of the cluster
+    for (j = 0; j < n; ++j)
+    {
+        for (e = sites[cl->members[j]].neighbors;
+             e < sites[cl->members[j]].neighbors +
+             sites[cl->members[j]].nNeighbors; ++e)
+        {
+            if (runprms->clusterOf[e->s] != id)
+            {
+                cl->rateOut[j] += e->rate;
+                continue;
+            }
+            k = clusterMember (cl, e->s);
+            A[j * n + k] -= e->rate;
+            rateIn[j] += e->rate;
+        }
+        out[j] = cl->rateOut[j];
+    }
+
+    // the LU decomposition, L is stored below the diagonal
+    for (p = 0; p < n; ++p)
+    {
+        A[p * n + p] = out[p];
+        for (j = p + 1; j < n; ++j)
+            A[p * n + p] -= A[p * n + j];
+        if (A[p * n + p] <= 0)
+            break;
+
+        for (i = p + 1; i < n; ++i)
+        {
+            A[i * n + p] /= A[p * n + p];
+            for (j = p + 1; j < n; ++j)
+                if (j != i)
+                    A[i * n + j] -= A[i * n + p] * A[p * n + j];
+            out[i] -= A[i * n + p] * out[p];
+        }
+    }
+
+    // the columns of N
+    for (k = 0; p == n && k < n; ++k)
+    {
+        for (i = 0; i < n; ++i)
+        {
+            x[i] = (i == k) ? 1.0 : 0.0;
+            for (j = 0; j < i; ++j)
+                x[i] -= A[i * n + j] * x[j];
+        }
+        for (i = n - 1; i >= 0; --i)
+        {
+            for (j = i + 1; j < n; ++j)
+                x[i] -= A[i * n + j] * x[j];
+            x[i] /= A[i * n + i];
+        }
+        for (j = 0; j < n; ++j)
+            cl->occupation[j * n + k] = x[j];
+    }
+
+    // the exit times, exit probabilities and hops inside
+    for (j = 0; p == n && j < n; ++j)
+    {
+        sum = 0.0;
+        for (k = 0; k < n; ++k)
+        {
+            cl->time[j] += cl->occupation[j * n + k];
+            cl->internalHops[j] += cl->occupation[j * n + k] * rateIn[k];
+            sum += cl->occupation[j * n + k] * cl->rateOut[k];
+            cl->exitProb[j * n + k] = sum;
+        }
+    }
+
+    // the positions of the members relative to the first one, along the
+    // edges inside the cluster
+    queue = (int *) malloc (sizeof (int) * n);
+    done = (bool *) calloc (n, sizeof (bool));
+    queue[0] = 0;
+    done[0] = true;
+    for (i = 0, j = 1; i < j; ++i)
+    {
+        for (e = sites[cl->members[queue[i]]].neighbors;
+             e < sites[cl->members[queue[i]]].neighbors +
+             sites[cl->members[queue[i]]].nNeighbors; ++e)
+        {
+            if (runprms->clusterOf[e->s] != id ||
+                done[k = clusterMember (cl, e->s)])
+                continue;
+
+            Vector dist = SLE_dist (e, runprms);
+            cl->offset[k].x = cl->offset[queue[i]].x + dist.x;
+            cl->offset[k].y = cl->offset[queue[i]].y + dist.y;
+            cl->offset[k].z = cl->offset[queue[i]].z + dist.z;
+            done[k] = true;
+            queue[j++] = k;
+        }
+    }
+
+    free (A);
+    free (queue);
+    free (done);
+
+    return p == n;
+}
+
+/*
+ * The mean time, which the carrier stays in the cluster of site s after
+ * entering it there.
+ */
+double
+MC_clusterTime (Site * s, RunParams * runprms)
+{
+    Cluster *cl = &runprms->clusters[runprms->clusterOf[s->index]];
+
+    return cl->time[clusterMember (cl, s->index)];
+}
+
+/*
+ * The hop, with which the carrier leaves the cluster of site s after
+ * entering it there. The member it leaves from is drawn from the exit
+ * probabilities, the destination from its rates out of the cluster.
+ */
+SLE *
+MC_clusterExit (Site * s, RunParams * runprms)
+{
+    int id = runprms->clusterOf[s->index], j, k;
+    Cluster *cl = &runprms->clusters[id];
+    Site *m;
+    SLE *dest = NULL;
+    double randomHopProb, probSum;
+
+    j = clusterMember (cl, s->index);
+    randomHopProb =
+        RNG_uniform (runprms) * cl->exitProb[j * cl->n + cl->n - 1];
+    for (k = 0; k < cl->n - 1 && cl->exitProb[j * cl->n + k] <= randomHopProb;
+         ++k);
+
+    m = &runprms->sites[cl->members[k]];
+    randomHopProb = RNG_uniform (runprms) * cl->rateOut[k];
+    probSum = 0.0;
+    for (j = 0; j < m->nNeighbors && (dest == NULL || probSum <= randomHopProb);
+         ++j)
+    {
+        if (runprms->clusterOf[m->neighbors[j].s] == id)
+            continue;
+        dest = &m->neighbors[j];
+        probSum += dest->rate;
+    }
+
+    return dest;
+}
+
+/*
+ * The statistics of a passage through the cluster of site s, which ends
+ * with the hop dest out of it. The displacement inside the cluster is
+ * added to dist, the time since the carrier entered is distributed over
+ * the members according to their expected occupation, and the expected
+ * hops inside are counted as saved.
+ */
+void
+MC_clusterLeave (Site * s, SLE * dest, Vector * dist, RunParams * runprms)
+{
+    Cluster *cl = &runprms->clusters[runprms->clusterOf[s->index]];
+    SiteStats *st = &runprms->stats;
+    int j = clusterMember (cl, s->index), k;
+    long e = dest - runprms->edges;
+    double elapsed = runprms->simulationTime - st->tempOccTime[s->index];
+
+    for (k = 0; k < cl->n; ++k)
+    {
+        st->totalOccTime[cl->members[k]] +=
+            elapsed * cl->occupation[j * cl->n + k] / cl->time[j];
+        if (e >= runprms->edgeOffset[cl->members[k]] &&
+            e < runprms->edgeOffset[cl->members[k] + 1])
+        {
+            dist->x += cl->offset[k].x - cl->offset[j].x;
+            dist->y += cl->offset[k].y - cl->offset[j].y;
+            dist->z += cl->offset[k].z - cl->offset[j].z;
+        }
+    }
+
+    runprms->nHopsSaved += cl->internalHops[j];
+}
+
+/*
+ * Tracks the sites, which the carrier visits, for --superbasin. This is
+ * called after every hop, the carrier just arrived at site s. If it
+ * hopped prms->superbasin times among at most prms->clustersize sites,
+ * these sites are a basin, which it leaves in one step like a cluster of
+ * --coarsegrain. This is exact at any time, since the future of the
+ * carrier only depends on the site it is at. A basin, which the carrier
+ * has just left, is released. The sites of the static clusters are not
+ * part of any basin.
+ */
+void
+MC_visitBasin (Site * s, RunParams * runprms)
+{
+    Params *prms = runprms->prms;
+    int k;
+
+    if (runprms->basin >= 0)
+        MC_resetBasin (runprms);
+
+    if (runprms->clusterOf[s->index] >= 0)
+    {
+        MC_resetBasin (runprms);
+        return;
+    }
+
+    // a new site starts a new set, if the set is full
+    for (k = 0; k < runprms->nBasinSites; ++k)
+        if (runprms->basinSites[k] == s->index)
+            break;
+    if (k == runprms->nBasinSites && k == prms->clustersize)
+    {
+        runprms->nBasinSites = 0;
+        runprms->nBasinHops = 0;
+        k = 0;
+    }
+    if (k == runprms->nBasinSites)
+        runprms->basinSites[runprms->nBasinSites++] = s->index;
+
+    if (++runprms->nBasinHops >= prms->superbasin &&
+        runprms->nBasinSites > 1)
+        enterBasin (runprms);
+}
+
+/*
+ * Releases the basin of --superbasin and starts a new set of sites, e.g.,
+ * when the carrier has left the basin or is placed again.
+ */
+void
+MC_resetBasin (RunParams * runprms)
+{
+    Cluster *cl;
+    int k;
+
+    if (runprms->basin >= 0)
+    {
+        cl = &runprms->clusters[runprms->basin];
+        for (k = 0; k < cl->n; ++k)
+            runprms->clusterOf[cl->members[k]] = -1;
+    }
+
+    runprms->basin = -1;
+    runprms->nBasinSites = 0;
+    runprms->nBasinHops = 0;
+}
+
+/*
+ * Turns the recently visited sites into the basin, which the carrier
+ * passes in one step. The solutions of the local master equation are
+ * kept in a cache indexed by the sorted sites, the carrier often returns
+ * to the same basin.
+ */
+void
+enterBasin (RunParams * runprms)
+{
+    Params *prms = runprms->prms;
+    int id, k, n = runprms->nBasinSites;
+    unsigned long hash = 0;
+    Cluster *cl;
+
+    insertionSortInt (runprms->basinSites, n);
+    for (k = 0; k < n; ++k)
+        hash = hash * 2654435761ul + runprms->basinSites[k];
+    id = runprms->nClusters + (hash >> 7) % BASIN_CACHE;
+    cl = &runprms->clusters[id];
+
+    for (k = 0; k < runprms->nBasinSites; ++k)
+        runprms->clusterOf[runprms->basinSites[k]] = id;
+    runprms->basin = id;
+
+    if (cl->time != NULL && cl->n == n &&
+        memcmp (cl->members, runprms->basinSites, sizeof (int) * n) == 0)
+        return;
+
+    if (cl->members == NULL)
+        cl->members = (int *) malloc (sizeof (int) * prms->clustersize);
+    cl->n = n;
+    memcpy (cl->members, runprms->basinSites, sizeof (int) * n);
+    freeCluster (cl);
+    if (!solveCluster (cl, id, runprms->sites, runprms))
+    {
+        MC_resetBasin (runprms);
+        freeCluster (cl);
+    }
+}
+
+/*
+ * Sorts the n integers a in ascending order.
+ */
+void
+insertionSortInt (int *a, int n)
+{
+    int i, j, x;
+
+    for (i = 1; i < n; ++i)
+    {
+        x = a[i];
+        for (j = i; j > 0 && a[j - 1] > x; --j)
+            a[j] = a[j - 1];
+        a[j] = x;
+    }
+}
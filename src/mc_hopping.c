@@ -23,40 +23,92 @@
 #include "hop.h"
 
 void hoppingStep (Carrier * carriers, RunParams * runprms);
-void hop (Carrier * c, SLE * dest, Vector * dist, RunParams * runprms);
-void updateCarrier (Carrier * carriers, RunParams * runprms);
+void hop (Carrier * c, SLE * dest, RunParams * runprms);
+void updateCarrier (Carrier * c, RunParams * runprms);
+void hoppingStepRejectionFree (Carrier * carriers, RunParams * runprms);
+void updateFreeRates (Site * s, Carrier * c, double sign,
+                      RunParams * runprms);
+void setFreeRate (Carrier * c, double rate, RunParams * runprms);
+void countFailedAttempts (Carrier * c, RunParams * runprms);
+void runHops (Carrier * carriers, RunParams * runprms, HopKernel kernel,
+              long nHops);
+void kernelMeanfieldRelaxation (Carrier * carriers, RunParams * runprms,
+                                long nHops);
+void kernelMeanfieldMeasurement (Carrier * carriers, RunParams * runprms,
+                                 long nHops);
+void kernelManyRelaxation (Carrier * carriers, RunParams * runprms,
+                           long nHops);
+void kernelManyMeasurement (Carrier * carriers, RunParams * runprms,
+                            long nHops);
 
 /*
  * This function runs the iteration of the simulation.  It keeps track of
  * the passed "time" (in arbitrary units) and ouputs the progress.
  */
 void
-MC_simulation (Site * sites, Carrier * carriers, RunParams * runprms,
-               int iReRun)
+MC_simulation (Carrier * carriers, RunParams * runprms, int iReRun)
 {
+    Params *prms = runprms->prms;
     int j;
     int ncarriers = 1;
+    HopKernel relaxation = NULL, measurement = NULL;
+    struct timeval start, half, end, generic, specialized;
 
     // is this the meanfield mode?
-    if (prms.many)
-        ncarriers = prms.ncarriers;
+    if (prms->many)
+        ncarriers = runprms->ncarriers;
+
+    // select the hopping kernels. The rejection-free mode and the
+    // clusters of --coarsegrain and --superbasin always use the generic
+    // hopping step.
+    if (!prms->rejectionfree && !prms->coarsegrain && prms->superbasin == 0)
+    {
+        relaxation =
+            prms->many ? kernelManyRelaxation : kernelMeanfieldRelaxation;
+        measurement =
+            prms->many ? kernelManyMeasurement : kernelMeanfieldMeasurement;
+    }
 
     // we need the current simulation time.
     double simTimeOld = runprms->simulationTime;
     runprms->nHops = 0;
     runprms->stat = false;
 
-    // relaxation, no time or hop counting
+    // relaxation, no time or hop counting. For --kernelbench, the first
+    // half is done with the generic hopping step.
+    gettimeofday (&start, NULL);
+    half = start;
     for (j = 0; j <= 100; j++)
     {
-        while (runprms->nHops < prms.relaxation / 100 * j)
-            hoppingStep (carriers, runprms);
-
-        output (O_SERIAL, "\r\tRelaxing...   (run %d of %d):\t%2d%%", iReRun,
-                prms.number_reruns, (int) j);
+        if (prms->kernelbench && j <= 50)
+            runHops (carriers, runprms, NULL, prms->relaxation / 100 * j);
+        else
+            runHops (carriers, runprms, relaxation,
+                     prms->relaxation / 100 * j);
+
+        if (j == 50)
+            gettimeofday (&half, NULL);
+
+        output (prms, O_SERIAL,
+                "\r\tRelaxing...   (run %d of %d):\t%2d%%", iReRun,
+                prms->number_reruns, (int) j);
         fflush (stdout);
     }
-    output (O_SERIAL, " Done.\n");
+    gettimeofday (&end, NULL);
+    output (prms, O_SERIAL, " Done.\n");
+
+    if (prms->kernelbench && prms->relaxation > 0)
+    {
+        timeval_subtract (&generic, &start, &half);
+        timeval_subtract (&specialized, &half, &end);
+        output (prms, O_BOTH,
+                "\tKernel benchmark (run %d): generic %lu hops/sec, specialized %lu hops/sec\n",
+                runprms->iRun,
+                (size_t) (prms->relaxation / 100 * 50 /
+                          (generic.tv_sec + generic.tv_usec / 1e6)),
+                (size_t) ((prms->relaxation - prms->relaxation / 100 * 50) /
+                          (specialized.tv_sec + specialized.tv_usec / 1e6)));
+    }
 
     // actual simulation, time and hop counting
     // we need to renormalize the carrier occupation time and simulation time, since
@@ -67,23 +119,39 @@ MC_simulation (Site * sites, Carrier * carriers, RunParams * runprms,
     for (j = 0; j < ncarriers; ++j)
         carriers[j].occTime -= (runprms->simulationTime - simTimeOld);
     runprms->simulationTime = simTimeOld;
+    if (prms->many)
+        EQ_build (runprms->queue, carriers);
+    if (prms->rejectionfree)
+        for (j = 0; j < ncarriers; ++j)
+            carriers[j].lastChange = runprms->simulationTime;
 
     for (j = 0; j <= 100; j++)
     {
-        while (runprms->nHops <= prms.simulation / 100 * j)
-            hoppingStep (carriers, runprms);
+        runHops (carriers, runprms, measurement,
+                 prms->simulation / 100 * j + 1);
 
-        output (O_SERIAL, "\r\tSimulating... (run %d of %d):\t%2d%%", iReRun,
-                prms.number_reruns, (int) j);
+        output (prms, O_SERIAL,
+                "\r\tSimulating... (run %d of %d):\t%2d%%", iReRun,
+                prms->number_reruns, (int) j);
         fflush (stdout);
     }
-    output (O_SERIAL, " Done.\n");
+    output (prms, O_SERIAL, " Done.\n");
 
     // finish statistics
     for (j = 0; j < runprms->nSites; ++j)
-        if (sites[j].tempOccTime > 0)
-            sites[j].totalOccTime +=
-                runprms->simulationTime - sites[j].tempOccTime;
+        if (runprms->stats.tempOccTime[j] > 0)
+            runprms->stats.totalOccTime[j] +=
+                runprms->simulationTime - runprms->stats.tempOccTime[j];
+
+    // the failed attempts of the rejection-free mode are only known on
+    // average, they are rounded to the nearest integer.
+    if (prms->rejectionfree)
+    {
+        for (j = 0; j < ncarriers; ++j)
+            countFailedAttempts (&carriers[j], runprms);
+        runprms->nFailedAttempts += lround (runprms->nFailedExpected);
+        runprms->nFailedExpected = 0.0;
+    }
 
     for (j = 0; j < ncarriers; ++j)
     {
@@ -94,6 +162,163 @@ MC_simulation (Site * sites, Carrier * carriers, RunParams * runprms,
 
 }
 
+/*
+ * Hops until runprms->nHops reaches nHops, either with one of the
+ * specialized kernels or, if kernel is NULL, with the generic
+ * hoppingStep().
+ */
+void
+runHops (Carrier * carriers, RunParams * runprms, HopKernel kernel,
+         long nHops)
+{
+    if (kernel != NULL)
+        kernel (carriers, runprms, nHops);
+    else
+        while (runprms->nHops < nHops)
+            hoppingStep (carriers, runprms);
+}
+
+/*
+ * The specialized version of hoppingStep(), hop() and updateCarrier() in
+ * one loop. many and stat are constants in the four kernels below, so
+ * the compiler removes all the branches on them from the inner loop. In
+ * the meanfield mode, there is only one carrier and no other site can be
+ * occupied, so the occupation of the sites is not tracked while the
+ * kernel runs.
+ */
+static inline void
+hoppingKernel (Carrier * carriers, RunParams * runprms, long nHops,
+               const bool many, const bool stat)
+{
+    Params *prms = runprms->prms;
+    Carrier *c = &carriers[0];
+    Site *sites = runprms->sites, *orig, *to;
+    SLE *dest = NULL, latticeDest;
+    SiteStats *st = &runprms->stats;
+    Vector dist;
+    double randomHopProb, probSum;
+    int i;
+
+    if (!many)
+        c->site->carrier = NULL;
+
+    while (runprms->nHops < nHops)
+    {
+        if (many)
+            c = &carriers[EQ_top (runprms->queue)];
+        orig = c->site;
+
+        // determine the next destination site
+        if (prms->implicitlattice)
+        {
+            randomHopProb =
+                (float) RNG_uniform (runprms) * orig->rateSum;
+            dest = MC_latticeNeighbor (orig, randomHopProb, runprms,
+                                       &latticeDest);
+        }
+        else if (prms->alias)
+        {
+            randomHopProb = RNG_uniform (runprms) * orig->nNeighbors;
+            i = (int) randomHopProb;
+            if (randomHopProb - i < orig->aliasTable[i].prob)
+                dest = &(orig->neighbors[i]);
+            else
+                dest = &(orig->neighbors[orig->aliasTable[i].alias]);
+        }
+        else
+        {
+            randomHopProb =
+                (float) RNG_uniform (runprms) * orig->rateSum;
+            probSum = 0.0;
+            for (i = 0; ((i < orig->nNeighbors) && (probSum <= randomHopProb));
+                 ++i)
+            {
+                dest = &(orig->neighbors[i]);
+                probSum += dest->rate;
+            }
+        }
+
+        runprms->simulationTime = c->occTime;
+        to = &sites[dest->s];
+
+        if (!many || to->carrier == NULL)
+        {
+            runprms->nHops++;
+
+            if (stat)
+            {
+                if (st->transitions != NULL)
+                    st->transitions[dest - runprms->edges]++;
+
+                st->totalOccTime[orig->index] +=
+                    runprms->simulationTime - st->tempOccTime[orig->index];
+                st->tempOccTime[orig->index] = 0.0;
+                st->tempOccTime[dest->s] = runprms->simulationTime;
+
+                dist = SLE_dist (dest, runprms);
+                c->dx += dist.x;
+                c->dy += dist.y;
+                c->dz += dist.z;
+
+                c->ddx += dist.x;
+                c->ddy += dist.y;
+                c->ddz += dist.z;
+
+                if (st->visited != NULL && orig->energy < to->energy)
+                    st->visitedUpward[dest->s]++;
+                else if (st->visited != NULL)
+                    st->visited[dest->s]++;
+            }
+
+            if (many)
+            {
+                orig->carrier = NULL;
+                to->carrier = c;
+            }
+            c->site = to;
+        }
+        else if (stat)
+        {
+            runprms->nFailedAttempts++;
+            c->nFailedAttempts++;
+        }
+
+        c->occTime +=
+            (float) RNG_exponential (runprms) / c->site->rateSum;
+        if (many)
+            EQ_update (runprms->queue, c->index, c->occTime);
+    }
+
+    if (!many)
+        c->site->carrier = c;
+}
+
+void
+kernelMeanfieldRelaxation (Carrier * carriers, RunParams * runprms,
+                           long nHops)
+{
+    hoppingKernel (carriers, runprms, nHops, false, false);
+}
+
+void
+kernelMeanfieldMeasurement (Carrier * carriers, RunParams * runprms,
+                            long nHops)
+{
+    hoppingKernel (carriers, runprms, nHops, false, true);
+}
+
+void
+kernelManyRelaxation (Carrier * carriers, RunParams * runprms, long nHops)
+{
+    hoppingKernel (carriers, runprms, nHops, true, false);
+}
+
+void
+kernelManyMeasurement (Carrier * carriers, RunParams * runprms, long nHops)
+{
+    hoppingKernel (carriers, runprms, nHops, true, true);
+}
+
 /*
  * This function executes one step of the simulation. It finds the carrier
  * or occupied site with the lowest occupation time and defines this as
@@ -104,31 +329,67 @@ MC_simulation (Site * sites, Carrier * carriers, RunParams * runprms,
 void
 hoppingStep (Carrier * carriers, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     Carrier *c = NULL;
-    SLE *dest = NULL;
+    SLE *dest = NULL, latticeDest;
     double randomHopProb, probSum;
     int i;
 
-    // heap
-    c = &carriers[0];
+    if (prms->rejectionfree)
+    {
+        hoppingStepRejectionFree (carriers, runprms);
+        return;
+    }
 
-    // determine the next destination site
-    randomHopProb = (float) gsl_rng_uniform (runprms->r) * c->site->rateSum;
-    probSum = 0.0;
-    for (i = 0; ((i < c->site->nNeighbors) && (probSum <= randomHopProb)); ++i)
+    // the carrier with the smallest occupation time hops next
+    c = &carriers[prms->many ? EQ_top (runprms->queue) : 0];
+
+    // determine the next destination site. A carrier in a cluster of
+    // --coarsegrain leaves it in one step.
+    if (runprms->clusterOf != NULL && runprms->clusterOf[c->site->index] >= 0)
+    {
+        dest = MC_clusterExit (c->site, runprms);
+    }
+    else if (prms->implicitlattice)
+    {
+        randomHopProb = (float) RNG_uniform (runprms) * c->site->rateSum;
+        dest = MC_latticeNeighbor (c->site, randomHopProb, runprms,
+                                   &latticeDest);
+    }
+    else if (prms->alias)
+    {
+        // alias method: the integer part of the random number selects
+        // the table entry, the fractional part decides between the entry
+        // and its alias
+        randomHopProb = RNG_uniform (runprms) * c->site->nNeighbors;
+        i = (int) randomHopProb;
+        if (randomHopProb - i < c->site->aliasTable[i].prob)
+            dest = &(c->site->neighbors[i]);
+        else
+            dest = &(c->site->neighbors[c->site->aliasTable[i].alias]);
+    }
+    else
     {
-        dest = &(c->site->neighbors[i]);
-        probSum += dest->rate;
+        randomHopProb = (float) RNG_uniform (runprms) * c->site->rateSum;
+        probSum = 0.0;
+        for (i = 0; ((i < c->site->nNeighbors) && (probSum <= randomHopProb));
+             ++i)
+        {
+            dest = &(c->site->neighbors[i]);
+            probSum += dest->rate;
+        }
     }
 
     runprms->simulationTime = c->occTime;
 
-    if (dest->s->carrier == NULL)
+    if (runprms->sites[dest->s].carrier == NULL)
     {
         // do the hopping and write some statistics
         runprms->nHops++;
 
-        hop (c, dest, &dest->dist, runprms);
+        hop (c, dest, runprms);
+        if (prms->superbasin > 0)
+            MC_visitBasin (c->site, runprms);
     }
     else
     {
@@ -138,7 +399,7 @@ hoppingStep (Carrier * carriers, RunParams * runprms)
             c->nFailedAttempts++;
         }
     }
-    updateCarrier (carriers, runprms);
+    updateCarrier (c, runprms);
 }
 
 /*
@@ -147,39 +408,50 @@ hoppingStep (Carrier * carriers, RunParams * runprms)
  * in the hopping process and all of the sites around these two sites.
  */
 void
-hop (Carrier * c, SLE * dest, Vector * dist, RunParams * runprms)
+hop (Carrier * c, SLE * dest, RunParams * runprms)
 {
     Site *orig = c->site;
+    Site *to = &runprms->sites[dest->s];
+    SiteStats *st = &runprms->stats;
+    Vector dist = SLE_dist (dest, runprms);
 
     // update origin site
     orig->carrier = NULL;
 
     if (runprms->stat)
     {
-        dest->nTransitions++;
-
-        orig->totalOccTime += runprms->simulationTime - orig->tempOccTime;
-        orig->tempOccTime = 0.0;
-        dest->s->tempOccTime = runprms->simulationTime;
-
-        c->dx += dist->x;
-        c->dy += dist->y;
-        c->dz += dist->z;
-
-        c->ddx += dist->x;
-        c->ddy += dist->y;
-        c->ddz += dist->z;
+        if (st->transitions != NULL)
+            st->transitions[dest - runprms->edges]++;
+
+        if (runprms->clusterOf != NULL && runprms->clusterOf[orig->index] >= 0)
+            MC_clusterLeave (orig, dest, &dist, runprms);
+        else
+            st->totalOccTime[orig->index] +=
+                runprms->simulationTime - st->tempOccTime[orig->index];
+        st->tempOccTime[orig->index] = 0.0;
+        st->tempOccTime[to->index] = runprms->simulationTime;
+
+        c->dx += dist.x;
+        c->dy += dist.y;
+        c->dz += dist.z;
+
+        c->ddx += dist.x;
+        c->ddy += dist.y;
+        c->ddz += dist.z;
     }
 
     // update carrier
-    c->site = dest->s;
+    c->site = to;
 
     // update destination site
-    dest->s->carrier = c;
-    if (runprms->stat && orig->energy < dest->s->energy)
-        dest->s->visitedUpward++;
-    else if (runprms->stat)
-        dest->s->visited++;
+    to->carrier = c;
+    if (runprms->stat && st->visited != NULL)
+    {
+        if (orig->energy < to->energy)
+            st->visitedUpward[to->index]++;
+        else
+            st->visited[to->index]++;
+    }
 
 }
 
@@ -220,36 +492,206 @@ timeval_subtract (struct timeval *result, struct timeval *y, struct timeval *x)
 }
 
 /*
- * This is a binary tree search for the carrier with the lowest occupation
- * time. It moves it to the top of the carriers list. The last jumped
- * carrier is assigned a new occupation time.
+ * The carrier that just jumped is assigned a new occupation time, in a
+ * cluster of --coarsegrain the time until it leaves the cluster. In the
+ * --many mode, the event queue is updated so that the carrier with the
+ * lowest occupation time is on top.
  */
 void
 updateCarrier (Carrier * c, RunParams * runprms)
 {
-    int smallest, i = 0;
+    Params *prms = runprms->prms;
+    if (runprms->clusterOf != NULL && runprms->clusterOf[c->site->index] >= 0)
+        c->occTime +=
+            RNG_exponential (runprms) * MC_clusterTime (c->site, runprms);
+    else
+        c->occTime +=
+            (float) RNG_exponential (runprms) / c->site->rateSum;
+
+    if (prms->many)
+        EQ_update (runprms->queue, c->index, c->occTime);
+}
+
+/*
+ * One step of the rejection-free (n-fold way) kinetic Monte Carlo. A
+ * carrier only attempts hops to unoccupied strong neighbors and to all of
+ * its weak neighbors (see MC_createIncomingEdges()), with the total rate
+ * c->rateSumFree. Only attempts to occupied weak neighbors can fail. When
+ * the occupation of a site changes, the waiting times of the carriers for
+ * which it is a strong neighbor are rescaled to their new rates, which is
+ * exact for exponentially distributed times. Simulated time and hop
+ * statistics have the same distribution as in hoppingStep(), the failed
+ * attempts to strong neighbors are accumulated from their expectation
+ * value.
+ */
+void
+hoppingStepRejectionFree (Carrier * carriers, RunParams * runprms)
+{
+    Params *prms = runprms->prms;
+    Carrier *c = &carriers[EQ_top (runprms->queue)];
+    Site *sites = runprms->sites, *orig = c->site;
+    SLE *dest = NULL;
+    double randomHopProb, probSum;
+    int i;
+
+    // the carrier that is due next has no free neighbor, so none of the
+    // carriers has. As in hoppingStep(), it attempts a hop with its full
+    // rate sum, which fails; the attempt is counted from its expectation
+    // value.
+    if (c->rateSumFree == 0)
+    {
+        runprms->simulationTime +=
+            RNG_exponential (runprms) / c->site->rateSum;
+        countFailedAttempts (c, runprms);
+        return;
+    }
 
-    c[0].occTime +=
-        (float) gsl_ran_exponential (runprms->r, 1.0) / c[0].site->rateSum;
+    runprms->simulationTime = c->occTime;
 
-    // children always sit at c[2i+1] and c[2i+2]
-    // do this only when the non-meanfield mc simulation is selected
-    Carrier tmp;
-    while (1 && prms.many)
+    // determine the next destination site
+    if (prms->alias)
+    {
+        // draw from the full distribution until the destination is not
+        // an occupied strong neighbor. This samples the restricted
+        // distribution.
+        do
+        {
+            randomHopProb = RNG_uniform (runprms) * orig->nNeighbors;
+            i = (int) randomHopProb;
+            if (randomHopProb - i >= orig->aliasTable[i].prob)
+                i = orig->aliasTable[i].alias;
+        }
+        while (i < orig->nStrong &&
+               sites[orig->neighbors[i].s].carrier != NULL);
+        dest = &(orig->neighbors[i]);
+    }
+    else
     {
-        smallest = (2 * i + 1 < prms.ncarriers &&
-                    c[i].occTime > c[2 * i + 1].occTime) ? 2 * i + 1 : i;
-        if (2 * i + 2 < prms.ncarriers &&
-            c[smallest].occTime > c[2 * i + 2].occTime)
-            smallest = 2 * i + 2;
+        randomHopProb = RNG_uniform (runprms) * c->rateSumFree;
+        probSum = 0.0;
+        for (i = 0; ((i < orig->nNeighbors) && (probSum <= randomHopProb));
+             ++i)
+        {
+            if ((i < orig->nStrong &&
+                 sites[orig->neighbors[i].s].carrier != NULL) ||
+                orig->neighbors[i].rate == 0)
+                continue;
+
+            dest = &(orig->neighbors[i]);
+            probSum += dest->rate;
+        }
+    }
+
+    countFailedAttempts (c, runprms);
+
+    // a weak neighbor may be occupied
+    if (sites[dest->s].carrier != NULL)
+    {
+        if (runprms->stat)
+        {
+            runprms->nFailedAttempts++;
+            c->nFailedAttempts++;
+        }
+
+        c->occTime += RNG_exponential (runprms) / c->rateSumFree;
+        EQ_update (runprms->queue, c->index, c->occTime);
+        return;
+    }
+
+    // do the hopping and write some statistics
+    runprms->nHops++;
+    hop (c, dest, runprms);
+
+    // the carriers around the vacated site gain a free neighbor, the
+    // ones around the destination lose one
+    updateFreeRates (orig, c, 1.0, runprms);
+    updateFreeRates (c->site, c, -1.0, runprms);
+
+    c->rateSumFree = MC_freeRateSum (c->site, runprms);
+    c->occTime = INFINITY;
+    if (c->rateSumFree > 0)
+        c->occTime = runprms->simulationTime +
+            RNG_exponential (runprms) / c->rateSumFree;
+    EQ_update (runprms->queue, c->index, c->occTime);
+}
 
-        if (i == smallest)
-            break;
+/*
+ * The site s was vacated (sign = 1) or occupied (sign = -1). The free
+ * rates of all carriers that have s as a strong neighbor, except for c,
+ * are updated.
+ */
+void
+updateFreeRates (Site * s, Carrier * c, double sign, RunParams * runprms)
+{
+    int k;
+    Carrier *n;
+    InEdge *e;
 
-        // swap
-        tmp = c[i];
-        c[i] = c[smallest];
-        c[smallest] = tmp;
-        i = smallest;
+    for (k = runprms->inOffset[s->index]; k < runprms->inOffset[s->index + 1];
+         ++k)
+    {
+        e = &runprms->inEdges[k];
+        n = e->s->carrier;
+        if (n != NULL && n != c && e->rate > 0)
+            setFreeRate (n, n->rateSumFree + sign * e->rate, runprms);
     }
 }
+
+/*
+ * Changes the free rate of carrier c and rescales its remaining waiting
+ * time accordingly.
+ */
+void
+setFreeRate (Carrier * c, double rate, RunParams * runprms)
+{
+    double t = runprms->simulationTime;
+    double old = c->rateSumFree;
+
+    countFailedAttempts (c, runprms);
+
+    // the sum is updated incrementally, so rounding errors accumulate.
+    // When only the weak neighbors are left, it is recomputed.
+    if (rate < runprms->rateSumWeak[c->site->index] + 1e-9 * c->site->rateSum)
+        rate = MC_freeRateSum (c->site, runprms);
+    c->rateSumFree = rate;
+
+    if (rate == 0)
+        c->occTime = INFINITY;
+    else if (old == 0)
+        c->occTime = t + RNG_exponential (runprms) / rate;
+    else
+        c->occTime = t + (c->occTime - t) * old / rate;
+
+    EQ_update (runprms->queue, c->index, c->occTime);
+}
+
+/*
+ * Adds the expected number of failed attempts of carrier c to occupied
+ * strong neighbors since its free rate last changed.
+ */
+void
+countFailedAttempts (Carrier * c, RunParams * runprms)
+{
+    if (runprms->stat)
+        runprms->nFailedExpected += (c->site->rateSum - c->rateSumFree) *
+            (runprms->simulationTime - c->lastChange);
+
+    c->lastChange = runprms->simulationTime;
+}
+
+/*
+ * Returns the sum of the rates from site s to its unoccupied strong
+ * neighbors and to all of its weak neighbors.
+ */
+double
+MC_freeRateSum (Site * s, RunParams * runprms)
+{
+    int i;
+    double rateSum = runprms->rateSumWeak[s->index];
+
+    for (i = 0; i < s->nStrong; ++i)
+        if (runprms->sites[s->neighbors[i].s].carrier == NULL)
+            rateSum += s->neighbors[i].rate;
+
+    return rateSum;
+}
@@ -22,41 +22,84 @@
 
 #include "hop.h"
 
-// we use this struct to create a temporary linked list
-// of the found neighbors.
-typedef struct linked_neighbors
-{
-    Site *s;
-    Vector dist;
-    struct linked_neighbors *next;
-} ln;
+// the fraction of the total rate of a site, whose destinations are
+// tracked exactly in the rejection-free mode
+#define STRONG_RATE_MASS 0.99
 
 // this struct is used to categorize sites
-// in space for easier finding of the neighbors
-typedef struct cell
+// in space for easier finding of the neighbors.
+// The sites in cell c are sites[first[c]] to
+// sites[first[c + 1] - 1]. Their positions and
+// energies are stored in the same order.
+typedef struct cells
+{
+    int *first;
+    int *sites;
+    float *x, *y, *z, *energy;
+    int maxCount;
+} Cells;
+
+// the pair candidates of a site, i.e., the following sites
+// of its own cell and the sites of the forward cells, with
+// their position j in the cell arrays. rate and rateBack are
+// the hopping rates to them and back. One per thread.
+typedef struct candidates
+{
+    int *j;
+    float *dx, *dy, *dz, *d2, *energy;
+    double *rate, *rateBack;
+} Candidates;
+
+// a neighbor during sorting. The key orders by descending
+// rate, then by index, old is its position before sorting
+// and reverse the one of its reverse edge.
+typedef struct neighbor_entry
+{
+    unsigned long key;
+    int old;
+    int reverse;
+} NeighborEntry;
+
+// the position of a site on the Morton curve
+typedef struct morton_key
 {
-    int counter;
+    unsigned long code;
     int index;
-    ln *siteList;
-} Cell;
+} MortonKey;
 
-// we use this struct to store softpairs
+// a softpair: the edge e of site i carries almost all of its rate, see
+// MC_removeSoftPairs()
 typedef struct softpair
 {
-    Site *i;
-    Site *j;
-    struct softpair *next;
+    int i;
+    long e;
 } Softpair;
 
 
 
-Cell *createCells (Site * sites, RunParams * runprms);
-Cell *getCell3D (Cell * cells, ssize_t x, ssize_t y, ssize_t z);
-void setNeighbors (Site * s, Cell * cells);
-double calcHoppingRate (Site i, Site j);
-Vector distance (Site * i, Site * j);
+void initSite (Site * s, Vector * pos, int i, gsl_rng * r, Params * prms);
+float drawEnergy (gsl_rng * r, Params * prms);
+void sortNeighbors (Site * sites, RunParams * runprms, bool presorted);
+void compactEdges (Site * sites, RunParams * runprms, int *newPosition);
+int findSoftPairs (Site * sites, RunParams * runprms, long *soft,
+                   Softpair * pairs);
+void mergeSoftPairs (Site * sites, RunParams * runprms, Softpair * pairs,
+                     int n);
+Cells createCells (RunParams * runprms);
+int getCell3D (ssize_t x, ssize_t y, ssize_t z, Params * prms);
+void freeCells (Cells * cells);
+Candidates createCandidates (Cells * cells);
+void freeCandidates (Candidates * cand);
+int forwardCells (Cells * cells, int c, RunParams * runprms, int *forward);
+int findPairs (Cells * cells, int c, int p, int *forward, int nForward,
+               Candidates * cand, bool rates, RunParams * runprms);
+void setNeighbors (Site * s, RunParams * runprms, NeighborEntry * sorted,
+                   SLE * copy, int *newPosition, bool presorted);
+void insertionSort (NeighborEntry * a, int n);
 int compare_neighbors (const void *a, const void *b);
 int compare_addtosites (const void *a, const void *b);
+int compare_morton (const void *a, const void *b);
+unsigned long spreadBits (unsigned long x);
 
 /*
  * creates n sites randomly distributed within a box of the size X*Y*Z
@@ -67,60 +110,52 @@ int compare_addtosites (const void *a, const void *b);
 Site *
 MC_createSites (RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     int i, j, k, l;
     Site *s, *s2;
+    Vector *pos = NULL;
+    gsl_rng *r;
 
+    // the positions of the implicit lattice follow from the index
     s = (Site *) malloc (runprms->nSites * sizeof (Site));
+    if (!prms->implicitlattice)
+        pos = (Vector *) malloc (runprms->nSites * sizeof (Vector));
 
-    // lattice case. Map site index to x,y,z coordinates
-    for (l = 0; l < prms.length_x; ++l)
-        for (j = 0; j < prms.length_y; ++j)
-            for (k = 0; k < prms.length_z; ++k)
-            {
-                i = ((l * prms.length_y + j) * prms.length_z) + k;
-                if (prms.lattice)
-                {
-                    s[i].x = (float) l;
-                    s[i].y = (float) j;
-                    s[i].z = (float) k;
-                }
-                else
-                {
-                    s[i].x =
-                        (float) gsl_rng_uniform (runprms->r) * prms.length_x;
-                    s[i].y =
-                        (float) gsl_rng_uniform (runprms->r) * prms.length_y;
-                    s[i].z =
-                        (float) gsl_rng_uniform (runprms->r) * prms.length_z;
-                }
-
-                if (!prms.gaussian)
-                    s[i].energy = (float) -1. * fabs(gsl_ran_exppow (
-                        runprms->r, 1., prms.exponent));
-                else
-                    s[i].energy = (float) gsl_ran_gaussian (runprms->r, 1.);
-                
-                s[i].carrier = NULL;
-                s[i].visited = 0;
-                s[i].visitedUpward = 0;
-                s[i].index = i;
-                s[i].totalOccTime = 0.0;
-                s[i].tempOccTime = 0.0;
-                s[i].neighbors = NULL;
-                s[i].nNeighbors = 0;
-                s[i].rateSum = 0.0;
-            }
+    // with counter-based random numbers, the sites are generated in
+    // blocks with independent streams, so they can be done in parallel
+    // with results that do not depend on the number of threads
+    if (prms->counterrng)
+    {
+#pragma omp parallel for private(i, r) schedule(static) \
+    num_threads(runprms->nthreads)
+        for (l = 0; l < (runprms->nSites + RNG_SITE_BLOCK - 1) /
+             RNG_SITE_BLOCK; ++l)
+        {
+            r = gsl_rng_alloc (prms->T);
+            RNG_setStream (r, runprms->rseed_used, runprms->iRun, 0,
+                           RNG_STREAM_SITES + l);
+            for (i = l * RNG_SITE_BLOCK;
+                 i < GSL_MIN ((l + 1) * RNG_SITE_BLOCK, runprms->nSites); ++i)
+                initSite (&s[i], pos ? &pos[i] : NULL, i, r, prms);
+            gsl_rng_free (r);
+        }
+    }
+    else
+    {
+        for (i = 0; i < runprms->nSites; ++i)
+            initSite (&s[i], pos ? &pos[i] : NULL, i, runprms->r, prms);
+    }
 
     // filter sites in case of cut-out
-    if (prms.cut_dos)
+    if (prms->cut_dos)
     {
         j = runprms->nSites;
         k = 0;
 
         for (i = 0; i < j; ++i)
         {
-            if (s[i].energy < prms.cut_out_energy &&
-                s[i].energy > prms.cut_out_energy - prms.cut_out_width)
+            if (s[i].energy < prms->cut_out_energy &&
+                s[i].energy > prms->cut_out_energy - prms->cut_out_width)
             {
                 s[i].index = -1;
                 runprms->nSites--;
@@ -134,6 +169,7 @@ MC_createSites (RunParams * runprms)
             {
                 s2[k] = s[i];
                 s2[k].index = k;
+                pos[k] = pos[i];
                 k++;
             }
 
@@ -143,16 +179,16 @@ MC_createSites (RunParams * runprms)
 
     // n dependency: cut out all the occupied sites following the fermi
     // distribution.
-    if (prms.ncarriers > 1 && !prms.many)
+    if (runprms->ncarriers > 1 && !prms->many)
     {
         j = runprms->nSites;
         k = 0;
-        double fermilevel = calcFermiEnergy ();
+        double fermilevel = calcFermiEnergy (runprms);
 
         for (i = 0; i < j; ++i)
         {
 
-            if (1 / (1 + exp ((s[i].energy - fermilevel) / prms.temperature)) >
+            if (1 / (1 + exp ((s[i].energy - fermilevel) / runprms->temperature)) >
                 (float) gsl_rng_uniform (runprms->r))
             {
                 s[i].index = -1;
@@ -167,6 +203,7 @@ MC_createSites (RunParams * runprms)
             {
                 s2[k] = s[i];
                 s2[k].index = k;
+                pos[k] = pos[i];
                 k++;
             }
 
@@ -175,22 +212,178 @@ MC_createSites (RunParams * runprms)
         s = s2;
     }
 
+    free (runprms->positions);
+    runprms->positions = pos;
+
+    // sort the sites along a space-filling curve
+    if (prms->reorder)
+        MC_reorderSites (s, runprms);
+    runprms->sites = s;
+
     // return s if no filter was applied
     return s;
 }
 
+/*
+ * Initializes site number i with random position pos (or the lattice
+ * position) and energy, using the random number generator r. pos is NULL
+ * for the implicit lattice.
+ */
+void
+initSite (Site * s, Vector * pos, int i, gsl_rng * r, Params * prms)
+{
+    // lattice case. Map site index to x,y,z coordinates
+    int l = i / (prms->length_y * prms->length_z);
+    int j = (i / prms->length_z) % prms->length_y;
+    int k = i % prms->length_z;
+
+    if (prms->lattice && pos != NULL)
+    {
+        pos->x = (float) l;
+        pos->y = (float) j;
+        pos->z = (float) k;
+    }
+    else if (!prms->lattice)
+    {
+        pos->x = (float) gsl_rng_uniform (r) * prms->length_x;
+        pos->y = (float) gsl_rng_uniform (r) * prms->length_y;
+        pos->z = (float) gsl_rng_uniform (r) * prms->length_z;
+    }
+
+    s->energy = drawEnergy (r, prms);
+    s->carrier = NULL;
+    s->index = i;
+    s->neighbors = NULL;
+    s->aliasTable = NULL;
+    s->nStrong = 0;
+    s->nNeighbors = 0;
+    s->rateSum = 0.0;
+}
+
+/*
+ * Draws a site energy from the density of states.
+ */
+float
+drawEnergy (gsl_rng * r, Params * prms)
+{
+    if (!prms->gaussian)
+        return (float) -1. * fabs(gsl_ran_exppow (
+            r, 1., prms->exponent));
+    else
+        return (float) gsl_ran_gaussian (r, 1.);
+}
+
+/*
+ * Draws new energies for all sites, which keep their positions, for point
+ * p > 0 of a sweep (--redrawenergies). With counter-based random numbers,
+ * the blocks of sites use the streams of MC_createSites(), but at the
+ * position of rerun p, which is not used otherwise.
+ */
+void
+MC_redrawEnergies (Site * sites, RunParams * runprms, int p)
+{
+    Params *prms = runprms->prms;
+    int i, l;
+    gsl_rng *r;
+
+    if (prms->counterrng)
+    {
+#pragma omp parallel for private(i, r) schedule(static) \
+    num_threads(runprms->nthreads)
+        for (l = 0; l < (runprms->nSites + RNG_SITE_BLOCK - 1) /
+             RNG_SITE_BLOCK; ++l)
+        {
+            r = gsl_rng_alloc (prms->T);
+            RNG_setStream (r, runprms->rseed_used, runprms->iRun, p,
+                           RNG_STREAM_SITES + l);
+            for (i = l * RNG_SITE_BLOCK;
+                 i < GSL_MIN ((l + 1) * RNG_SITE_BLOCK, runprms->nSites); ++i)
+                sites[i].energy = drawEnergy (r, prms);
+            gsl_rng_free (r);
+        }
+    }
+    else
+    {
+        for (i = 0; i < runprms->nSites; ++i)
+            sites[i].energy = drawEnergy (runprms->r, prms);
+    }
+}
+
+/*
+ * Sorts the sites along a Morton (Z-order) curve. Every coordinate is
+ * divided into 1024 intervals and the bits of the three interval numbers
+ * are interleaved, so that sites that are close in space are mostly close
+ * in memory, too. The edges and reverse edges of the neighbor lists store
+ * site indices, so this has to happen before MC_createHoppingRates().
+ * runprms->siteOrder stores the original index of every site for the
+ * output.
+ */
+void
+MC_reorderSites (Site * sites, RunParams * runprms)
+{
+    Params *prms = runprms->prms;
+    int i;
+    Site *copy = (Site *) malloc (sizeof (Site) * runprms->nSites);
+    Vector *pos = runprms->positions;
+    Vector *posCopy = (Vector *) malloc (sizeof (Vector) * runprms->nSites);
+    MortonKey *keys = (MortonKey *) malloc (sizeof (MortonKey) *
+                                            runprms->nSites);
+
+    for (i = 0; i < runprms->nSites; ++i)
+    {
+        keys[i].code =
+            spreadBits (pos[i].x * 1024 / prms->length_x) |
+            spreadBits (pos[i].y * 1024 / prms->length_y) << 1 |
+            spreadBits (pos[i].z * 1024 / prms->length_z) << 2;
+        keys[i].index = i;
+    }
+    qsort (keys, runprms->nSites, sizeof (MortonKey), compare_morton);
+
+    memcpy (copy, sites, sizeof (Site) * runprms->nSites);
+    memcpy (posCopy, pos, sizeof (Vector) * runprms->nSites);
+    free (runprms->siteOrder);
+    runprms->siteOrder = (int *) malloc (sizeof (int) * runprms->nSites);
+
+    for (i = 0; i < runprms->nSites; ++i)
+    {
+        sites[i] = copy[keys[i].index];
+        sites[i].index = i;
+        pos[i] = posCopy[keys[i].index];
+        runprms->siteOrder[i] = keys[i].index;
+    }
+
+    free (copy);
+    free (posCopy);
+    free (keys);
+}
+
+/*
+ * Inserts two zero bits between each of the lower 10 bits of x.
+ */
+unsigned long
+spreadBits (unsigned long x)
+{
+    x &= 0x3ff;
+    x = (x | (x << 16)) & 0x30000ff;
+    x = (x | (x << 8)) & 0x300f00f;
+    x = (x | (x << 4)) & 0x30c30c3;
+    x = (x | (x << 2)) & 0x9249249;
+    return x;
+}
+
 /*
  * allocate carrier array and initialize the values
  */
 Carrier *
-MC_createCarriers ()
+MC_createCarriers (RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     int i, ncarriers = 1;
     Carrier *c;
 
     // is this the meanfield mode?
-    if (prms.many)
-        ncarriers = prms.ncarriers;
+    if (prms->many)
+        ncarriers = runprms->ncarriers;
 
     // allocate carrier memory
     c = (Carrier *) malloc (sizeof (Carrier) * ncarriers);
@@ -222,15 +415,15 @@ MC_createCarriers ()
 void
 MC_distributeCarriers (Carrier * c, Site * sites, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     int i;
-    Carrier tmp;
     int ncarriers = 1;
 
     // is this the meanfield mode?
-    if (prms.many)
-        ncarriers = prms.ncarriers;
+    if (prms->many)
+        ncarriers = runprms->ncarriers;
 
-    // select prms.ncarriers random sites for the carriers
+    // select the ncarriers random sites for the carriers
     Site *sample = malloc (ncarriers * sizeof (Site));
     gsl_ran_choose (runprms->r, sample, ncarriers, sites,
                     runprms->nSites, sizeof (Site));
@@ -239,438 +432,1194 @@ MC_distributeCarriers (Carrier * c, Site * sites, RunParams * runprms)
     for (i = 0; i < runprms->nSites; ++i)
     {
         sites[i].carrier = NULL;
-        sites[i].tempOccTime = 0;
         sites[i].index = i;
     }
+    if (runprms->stats.tempOccTime != NULL)
+        memset (runprms->stats.tempOccTime, 0,
+                sizeof (float) * runprms->nSites);
+    if (prms->superbasin > 0)
+        MC_resetBasin (runprms);
 
     // distribute carriers 
     for (i = 0; i < ncarriers; ++i)
     {
         c[i].site = &sites[sample[i].index];
-        c[i].occTime = runprms->simulationTime +
-            (float) gsl_ran_exponential (runprms->r, 1.0) / c[i].site->rateSum;
-
-        // now insert the carrier into the heap
-        while (i > 0 && c[i].occTime < c[i / 2].occTime && prms.many)
-        {
-            tmp = c[i];
-            c[i] = c[i / 2];
-            c[i / 2] = tmp;
-            i /= 2;
-        }
+        if (runprms->clusterOf != NULL &&
+            runprms->clusterOf[c[i].site->index] >= 0)
+            c[i].occTime = runprms->simulationTime +
+                gsl_ran_exponential (runprms->r, 1.0) *
+                MC_clusterTime (c[i].site, runprms);
+        else if (!prms->rejectionfree)
+            c[i].occTime = runprms->simulationTime +
+                (float) gsl_ran_exponential (runprms->r,
+                                             1.0) / c[i].site->rateSum;
         c[i].ddx = 0.0;
         c[i].ddy = 0.0;
         c[i].ddz = 0.0;
         c[i].site->carrier = &c[i];
-        c[i].site->tempOccTime = 0.000001;
+        if (runprms->stats.tempOccTime != NULL)
+            runprms->stats.tempOccTime[c[i].site->index] = 0.000001;
     }
 
+    // in the rejection-free mode, the escape rate of a carrier depends on
+    // the occupation of its neighbors, so the times can only be drawn
+    // after all carriers are placed
+    if (prms->rejectionfree)
+        for (i = 0; i < ncarriers; ++i)
+        {
+            c[i].rateSumFree = MC_freeRateSum (c[i].site, runprms);
+            c[i].lastChange = runprms->simulationTime;
+            c[i].occTime = INFINITY;
+            if (c[i].rateSumFree > 0)
+                c[i].occTime = runprms->simulationTime +
+                    gsl_ran_exponential (runprms->r, 1.0) / c[i].rateSumFree;
+        }
+
+    // now insert the carriers into the event queue
+    if (prms->many)
+        EQ_build (runprms->queue, c);
+
     free (sample);
 }
 
+/*
+ * Prepares the rates for point p of the sweep (--temperatures, --fields).
+ * The neighbors are searched for the first point only, for the following
+ * ones the rates are recalculated, with new site energies for
+ * --redrawenergies. Without a sweep, the run keeps the temperature and
+ * field of its configuration.
+ */
+void
+MC_setPoint (Site * sites, RunParams * runprms, int p)
+{
+    Params *prms = runprms->prms;
+    runprms->iPoint = p;
+    if (prms->npoints > 1)
+    {
+        runprms->temperature = prms->temperatures[p];
+        runprms->field = prms->fields[p];
+    }
+
+    if (p > 0 && prms->redrawenergies)
+        MC_redrawEnergies (sites, runprms, p);
+
+    if (prms->implicitlattice)
+        MC_createStencil (sites, runprms);
+    else if (p == 0)
+        MC_createHoppingRates (sites, runprms);
+    else
+        MC_updateHoppingRates (sites, runprms);
+
+    if (prms->ratemass < 1)
+        MC_truncateNeighbors (sites, runprms);
+    if (prms->removesoftpairs)
+        MC_removeSoftPairs (sites, runprms);
+    if (prms->coarsegrain || prms->superbasin > 0)
+        MC_createClusters (sites, runprms);
+}
+
 /*
  * Divides the sample into equally sized cells, so that it's easier
  * to keep track of relevant neighbors. One Cell has the size
  * 2 * rc * a, where rc is the cut-off radius for the hops, 
  * a is the localization length of the WF. 
- * It also stores all the sites that lay within the cell
- * into a linked list which is a member of the cell struct.
+ * It also stores the indices, positions and energies of all the sites
+ * that lay within the cells, sorted by cell with a counting sort.
+ * Within a cell, they are in descending order.
  */
-Cell *
-createCells (Site * sites, RunParams * runprms)
+Cells
+createCells (RunParams * runprms)
 {
-    int i, tx, ty, tz, nCells;
-    Cell *c, *temp;
-    ln *head;
-
-    nCells = prms.nx * prms.ny * prms.nz;
-
-    c = (Cell *) malloc (nCells * sizeof (Cell));
+    Params *prms = runprms->prms;
+    int i, k, nCells;
+    int *cellOf, *fill;
+    Cells c;
+    Vector *pos = runprms->positions;
+
+    nCells = prms->nx * prms->ny * prms->nz;
+
+    c.first = (int *) calloc (nCells + 1, sizeof (int));
+    c.sites = (int *) malloc (runprms->nSites * sizeof (int));
+    c.x = (float *) malloc (runprms->nSites * sizeof (float));
+    c.y = (float *) malloc (runprms->nSites * sizeof (float));
+    c.z = (float *) malloc (runprms->nSites * sizeof (float));
+    c.energy = (float *) malloc (runprms->nSites * sizeof (float));
+    cellOf = (int *) malloc (runprms->nSites * sizeof (int));
+
+    // count the sites in every cell
+    for (i = 0; i < runprms->nSites; ++i)
+    {
+        cellOf[i] = getCell3D (pos[i].x / prms->cutoff_radius,
+                               pos[i].y / prms->cutoff_radius,
+                               pos[i].z / prms->cutoff_radius, prms);
+        c.first[cellOf[i] + 1]++;
+    }
 
+    c.maxCount = 0;
     for (i = 0; i < nCells; ++i)
     {
-        c[i].counter = 0;
-        c[i].siteList = NULL;
-        c[i].index = i;
+        c.maxCount = GSL_MAX (c.maxCount, c.first[i + 1]);
+        c.first[i + 1] += c.first[i];
     }
 
-    for (i = 0; i < runprms->nSites; ++i)
+    // and sort them in
+    fill = (int *) malloc (nCells * sizeof (int));
+    memcpy (fill, c.first, nCells * sizeof (int));
+    for (i = runprms->nSites - 1; i >= 0; --i)
     {
-        tx = sites[i].x / prms.cutoff_radius;
-        ty = sites[i].y / prms.cutoff_radius;
-        tz = sites[i].z / prms.cutoff_radius;
+        k = fill[cellOf[i]]++;
+        c.sites[k] = i;
+        c.x[k] = pos[i].x;
+        c.y[k] = pos[i].y;
+        c.z[k] = pos[i].z;
+        c.energy[k] = runprms->sites[i].energy;
+    }
 
-        temp = getCell3D (c, tx, ty, tz);
-        if (temp->counter == 0)
-            temp->siteList = NULL;
+    free (fill);
+    free (cellOf);
 
-        temp->counter++;
+    return c;
+}
 
-        head = temp->siteList;
-        temp->siteList = (ln *) malloc (sizeof (ln));
-        temp->siteList->s = &sites[i];
-        temp->siteList->next = head;
-    }
+void
+freeCells (Cells * cells)
+{
+    free (cells->first);
+    free (cells->sites);
+    free (cells->x);
+    free (cells->y);
+    free (cells->z);
+    free (cells->energy);
+}
 
-    return c;
+/*
+ * Allocates the candidate arrays for the cells around a site.
+ */
+Candidates
+createCandidates (Cells * cells)
+{
+    Candidates cand;
+    int n = 27 * cells->maxCount;
+
+    cand.j = (int *) malloc (n * sizeof (int));
+    cand.dx = (float *) malloc (n * sizeof (float));
+    cand.dy = (float *) malloc (n * sizeof (float));
+    cand.dz = (float *) malloc (n * sizeof (float));
+    cand.d2 = (float *) malloc (n * sizeof (float));
+    cand.energy = (float *) malloc (n * sizeof (float));
+    cand.rate = (double *) malloc (n * sizeof (double));
+    cand.rateBack = (double *) malloc (n * sizeof (double));
+
+    return cand;
+}
+
+void
+freeCandidates (Candidates * cand)
+{
+    free (cand->j);
+    free (cand->dx);
+    free (cand->dy);
+    free (cand->dz);
+    free (cand->d2);
+    free (cand->energy);
+    free (cand->rate);
+    free (cand->rateBack);
 }
 
 /*
- * This function creates the array Site.neighbors, assigning neighbors of
- * the sites and the corresponding hopping rate to it. It takes a while,
- * especially for big values of nSites.  It is also the main consumer of
- * memory!!
+ * This function creates the neighbor graph, assigning neighbors of the
+ * sites and the corresponding hopping rate to it. It is stored in one
+ * array runprms->edges (compressed sparse rows): a first pass counts the
+ * neighbors of every site, which gives the offsets of their ranges, and a
+ * second pass fills them. Site.neighbors points to the range of the site.
+ *
+ * Every pair of sites is found only once, from the site that comes first
+ * in the cell order (see forwardCells()), and both directed edges are
+ * written at the same time. runprms->reverse links them. Both passes are
+ * distributed over the cells and the threads, the ranges are sorted in
+ * the end, which makes the result independent of the number of threads.
+ * It takes a while, especially for big values of nSites.  It is also the
+ * main consumer of memory!!
  */
 void
 MC_createHoppingRates (Site * sites, RunParams * runprms)
 {
-    int k, l;
-    ln *sList, *tmp;
-    Cell *cells = (Cell *) createCells (sites, runprms);
+    Params *prms = runprms->prms;
+    int i, c, p, k, l, a, b, n, nForward, forward[26];
+    int nCells = prms->nx * prms->ny * prms->nz;
+    long ka, kb, *fill;
+    Cells cells = createCells (runprms);
+    Candidates cand;
+    SLE *ea, *eb;
+
+    for (i = 0; i < runprms->nSites; ++i)
+        sites[i].nNeighbors = 0;
+
+    // count the neighbors and set up the offsets
+#pragma omp parallel private(cand, forward, nForward, p, k, n) \
+    num_threads(runprms->nthreads)
+    {
+        cand = createCandidates (&cells);
+#pragma omp for schedule(dynamic, 16)
+        for (c = 0; c < nCells; ++c)
+        {
+            nForward = forwardCells (&cells, c, runprms, forward);
+            for (p = cells.first[c]; p < cells.first[c + 1]; ++p)
+            {
+                n = findPairs (&cells, c, p, forward, nForward, &cand, false,
+                               runprms);
+#pragma omp atomic
+                sites[cells.sites[p]].nNeighbors += n;
+                for (k = 0; k < n; ++k)
+#pragma omp atomic
+                    sites[cells.sites[cand.j[k]]].nNeighbors++;
+            }
+        }
+        freeCandidates (&cand);
+    }
+
+    free (runprms->edgeOffset);
+    runprms->edgeOffset = (long *) malloc (sizeof (long) *
+                                           (runprms->nSites + 1));
+    runprms->edgeOffset[0] = 0;
+    for (i = 0; i < runprms->nSites; ++i)
+        runprms->edgeOffset[i + 1] = runprms->edgeOffset[i] +
+            sites[i].nNeighbors;
+
+    free (runprms->edges);
+    free (runprms->reverse);
+    runprms->edges = (SLE *) malloc (sizeof (SLE) *
+                                     runprms->edgeOffset[runprms->nSites]);
+    runprms->reverse = (int *) malloc (sizeof (int) *
+                                       runprms->edgeOffset[runprms->nSites]);
+    for (i = 0; i < runprms->nSites; ++i)
+        sites[i].neighbors = &runprms->edges[runprms->edgeOffset[i]];
 
+    // the pairs, in the order in which the threads find them. fill is
+    // the next free edge of every site.
+    fill = (long *) malloc (sizeof (long) * runprms->nSites);
+    memcpy (fill, runprms->edgeOffset, sizeof (long) * runprms->nSites);
     for (l = 0; l < 100; ++l)
     {
-        // this weirdness with 99 takes care of site numbers that
+        // this weirdness with 99 takes care of cell numbers that
         // cannot be divided by 100.
-        for (k = l * runprms->nSites / 99; k < ((l + 1) * runprms->nSites / 99);
-             ++k)
-            if (k < runprms->nSites)
-                setNeighbors (&sites[k], cells);
+#pragma omp parallel private(cand, forward, nForward, p, k, n, a, b, ka, kb, ea, eb) \
+    num_threads(runprms->nthreads)
+        {
+            cand = createCandidates (&cells);
+#pragma omp for schedule(dynamic, 1)
+            for (c = l * nCells / 99; c < ((l + 1) * nCells / 99); ++c)
+            {
+                if (c >= nCells)
+                    continue;
+
+                nForward = forwardCells (&cells, c, runprms, forward);
+                for (p = cells.first[c]; p < cells.first[c + 1]; ++p)
+                {
+                    n = findPairs (&cells, c, p, forward, nForward, &cand,
+                                   true, runprms);
+                    a = cells.sites[p];
+                    for (k = 0; k < n; ++k)
+                    {
+                        b = cells.sites[cand.j[k]];
+#pragma omp atomic capture
+                        ka = fill[a]++;
+#pragma omp atomic capture
+                        kb = fill[b]++;
+
+                        ea = &runprms->edges[ka];
+                        ea->s = b;
+                        ea->rate = cand.rate[k];
+                        ea->dist[0] = lround (cand.dx[k] / prms->dist_unit);
+                        ea->dist[1] = lround (cand.dy[k] / prms->dist_unit);
+                        ea->dist[2] = lround (cand.dz[k] / prms->dist_unit);
+
+                        eb = &runprms->edges[kb];
+                        eb->s = a;
+                        eb->rate = cand.rateBack[k];
+                        eb->dist[0] = -ea->dist[0];
+                        eb->dist[1] = -ea->dist[1];
+                        eb->dist[2] = -ea->dist[2];
+
+                        runprms->reverse[ka] = kb - runprms->edgeOffset[b];
+                        runprms->reverse[kb] = ka - runprms->edgeOffset[a];
+                    }
+                }
+            }
+            freeCandidates (&cand);
+        }
 
-        output (O_SERIAL, "\r\tInitializing...: \t\t%2d%%", (int) l);
+        output (prms, O_SERIAL, "\r\tInitializing...: \t\t%2d%%", (int) l);
         fflush (stdout);
     }
-    output (O_SERIAL, " Done.\n");
+    free (fill);
+    freeCells (&cells);
+
+    sortNeighbors (sites, runprms, false);
+
+    output (prms, O_SERIAL, " Done.\n");
+}
+
+/*
+ * Recalculates the rates of the neighbor graph for the temperature and
+ * field in runprms, e.g., for the next point of a sweep. The neighbors
+ * only depend on the positions and the cut-off radius, so they are kept.
+ * The rates are calculated from the positions like in findPairs(), which
+ * takes one pass over the edges instead of the search in the cells.
+ */
+void
+MC_updateHoppingRates (Site * sites, RunParams * runprms)
+{
+    Params *prms = runprms->prms;
+    int i, k;
+    float lx = prms->length_x, ly = prms->length_y, lz = prms->length_z;
+    float dx, dy, dz, d2, dE, field = runprms->field;
+    double spatial, invLoclength = 1.0 / runprms->loclength;
+    double invTemperature =
+        (runprms->temperature > 0) ? 1.0 / runprms->temperature : 0;
+    bool zeroTemperature = (runprms->temperature == 0);
+    float *energy = (float *) malloc (sizeof (float) * runprms->nSites);
+    Vector *a, *b;
+    SLE *e;
+
+    // the energies of the neighbors are read in random order, a compact
+    // copy of them stays in the cache
+    for (i = 0; i < runprms->nSites; ++i)
+        energy[i] = sites[i].energy;
 
-    // free cells
-    for (l = 0; l < prms.nx * prms.ny * prms.nz; ++l)
+#pragma omp parallel for private(k, dx, dy, dz, d2, dE, spatial, a, b, e) schedule(dynamic, 1024) \
+    num_threads(runprms->nthreads)
+    for (i = 0; i < runprms->nSites; ++i)
     {
-        sList = cells[l].siteList;
-        while (sList)
+        a = &runprms->positions[i];
+#pragma omp simd private(dx, dy, dz, d2, dE, spatial, b, e)
+        for (k = 0; k < sites[i].nNeighbors; ++k)
         {
-            tmp = sList->next;
-            free (sList);
-            sList = tmp;
+            e = &sites[i].neighbors[k];
+            b = &runprms->positions[e->s];
+            dx = b->x - a->x;
+            dy = b->y - a->y;
+            dz = b->z - a->z;
+            dx -= lx * rintf (dx / lx);
+            dy -= ly * rintf (dy / ly);
+            dz -= lz * rintf (dz / lz);
+            d2 = dx * dx + dy * dy + dz * dz;
+
+            dE = energy[e->s] - energy[i] - field * dz;
+            spatial = -2.0 * sqrt (d2) * invLoclength;
+            e->rate = exp (spatial - ((dE > 0) ? dE * invTemperature : 0.0));
+            if (zeroTemperature && dE > 0)
+                e->rate = 0.0;
         }
     }
 
-    free (cells);
+    free (energy);
+
+    // the neighbors are still sorted by the previous rates
+    sortNeighbors (sites, runprms, true);
+
+    output (prms, O_SERIAL, "\tUpdating rates...: \t\tDone.\n");
 }
 
 /*
- * This function removes the found softpairs, using the algorithm
- * described in the PhD Thesis of Fredrik Jansson based ok xyz.
+ * Sorts the neighbor lists of all sites by rate and sums the rates up,
+ * see setNeighbors(), and updates the reverse edges.
  */
 void
-MC_removeSoftPairs (Site * sites, RunParams * runprms)
+sortNeighbors (Site * sites, RunParams * runprms, bool presorted)
+{
+    int i, maxNeighbors = 0;
+    int *newPosition;
+    long e;
+    NeighborEntry *sorted;
+    SLE *copy;
+
+    for (i = 0; i < runprms->nSites; ++i)
+        maxNeighbors = GSL_MAX (maxNeighbors, sites[i].nNeighbors);
+
+    newPosition = (int *) malloc (sizeof (int) *
+                                  runprms->edgeOffset[runprms->nSites]);
+#pragma omp parallel private(sorted, copy) num_threads(runprms->nthreads)
+    {
+        sorted = (NeighborEntry *) malloc (sizeof (NeighborEntry) *
+                                           GSL_MAX (maxNeighbors, 1));
+        copy = (SLE *) malloc (sizeof (SLE) * GSL_MAX (maxNeighbors, 1));
+#pragma omp for schedule(dynamic, 1024)
+        for (i = 0; i < runprms->nSites; ++i)
+            setNeighbors (&sites[i], runprms, sorted, copy, newPosition,
+                          presorted);
+        free (sorted);
+        free (copy);
+    }
+
+#pragma omp parallel for schedule(static) num_threads(runprms->nthreads)
+    for (e = 0; e < runprms->edgeOffset[runprms->nSites]; ++e)
+        runprms->reverse[e] =
+            newPosition[runprms->edgeOffset[runprms->edges[e].s] +
+                        runprms->reverse[e]];
+    free (newPosition);
+}
+
+/*
+ * Truncates the neighbor graph to the fastest neighbors of every site,
+ * which make up the fraction prms->ratemass of its total rate. The ranges
+ * are sorted by rate, so these are the first nKeep[i] of site i. Both
+ * directions of a pair stay if one of them is needed, so that every edge
+ * keeps its reverse. The rate sums are reduced to the kept rates, the
+ * discarded fraction of the total rate is stored in runprms.
+ */
+void
+MC_truncateNeighbors (Site * sites, RunParams * runprms)
 {
-    Softpair *softpair, *temp, *newSoftpair = NULL, *sp = NULL;
-    int j, i, nSoftPairs = 0;
-    bool ignore;
-    SLE *ntemp = NULL, *neighbor = NULL;
-    float rateb, rateab, ratebx = 0.0, rateSum;
+    Params *prms = runprms->prms;
+    int i, k, n, *nKeep, *newPosition;
+    long e, nEdges = runprms->edgeOffset[runprms->nSites];
+    double rateSum, totalRate = 0.0, discarded = 0.0, maxFraction = 0.0;
+    SLE *edge;
+
+    nKeep = (int *) malloc (sizeof (int) * runprms->nSites);
+    newPosition = (int *) malloc (sizeof (int) * nEdges);
+
+    // the neighbors each site needs itself. Sites without any rate keep
+    // all of them.
+#pragma omp parallel for private(k, rateSum) schedule(dynamic, 1024) \
+    num_threads(runprms->nthreads)
+    for (i = 0; i < runprms->nSites; ++i)
+    {
+        rateSum = 0.0;
+        for (k = 0; k < sites[i].nNeighbors &&
+             rateSum < prms->ratemass * sites[i].rateSum; ++k)
+            rateSum += sites[i].neighbors[k].rate;
+        nKeep[i] = (k > 0) ? k : sites[i].nNeighbors;
+    }
 
-    // find softpairs
-    for (j = 0; j < runprms->nSites; ++j)
+    // the new positions of the kept edges, -1 for the others
+#pragma omp parallel for private(k, n, e, edge) schedule(dynamic, 1024) \
+    num_threads(runprms->nthreads)
+    for (i = 0; i < runprms->nSites; ++i)
     {
-        for (i = 0; i < sites[j].nNeighbors; ++i)
+        for (k = 0, n = 0; k < sites[i].nNeighbors; ++k)
         {
-            if (sites[j].neighbors[i].rate / sites[j].rateSum >
-                prms.softpairthreshold)
-            {
-                newSoftpair = (Softpair *) malloc (sizeof (Softpair));
-                newSoftpair->i = &sites[j];
-                newSoftpair->j = sites[j].neighbors[i].s;
-                newSoftpair->next = sp;
-                sp = newSoftpair;
-                nSoftPairs++;
-            }
+            e = runprms->edgeOffset[i] + k;
+            edge = &runprms->edges[e];
+            newPosition[e] = -1;
+            if (k < nKeep[i] || runprms->reverse[e] < nKeep[edge->s])
+                newPosition[e] = n++;
         }
     }
 
-    if (nSoftPairs > 0)
+    compactEdges (sites, runprms, newPosition);
+
+    // the rate sums are reduced to the kept rates
+    for (i = 0; i < runprms->nSites; ++i)
     {
-        // some output
-        output (O_SERIAL, "\tRemoving Softpairs...:");
+        rateSum = 0.0;
+        for (k = 0; k < sites[i].nNeighbors; ++k)
+            rateSum += sites[i].neighbors[k].rate;
+
+        totalRate += sites[i].rateSum;
+        discarded += sites[i].rateSum - rateSum;
+        if (sites[i].rateSum > 0)
+            maxFraction = GSL_MAX (maxFraction,
+                                   1.0 - rateSum / sites[i].rateSum);
+
+        sites[i].rateSum = rateSum;
+    }
+
+    runprms->discardedRate = (totalRate > 0) ? discarded / totalRate : 0.0;
+    runprms->discardedRateMax = maxFraction;
+
+    output (prms, O_SERIAL,
+            "\tTruncating neighbors...: \tDone. %ld of %ld edges "
+            "kept, %e of the rate discarded (max. %e per site).\n",
+            runprms->edgeOffset[runprms->nSites], nEdges,
+            runprms->discardedRate, runprms->discardedRateMax);
+
+    free (nKeep);
+    free (newPosition);
+}
 
-        temp = newSoftpair;
-        softpair = newSoftpair;
+/*
+ * Removes the edges e with newPosition[e] < 0 from the neighbor graph, in
+ * place. The others move to position newPosition[e] of the range of their
+ * site. Both directions of a pair have to be removed together, so that
+ * every edge keeps its reverse. The rate sums are left alone.
+ */
+void
+compactEdges (Site * sites, RunParams * runprms, int *newPosition)
+{
+    int i, n;
+    long e, *oldOffset;
+    SLE *edge;
+
+    oldOffset = (long *) malloc (sizeof (long) * (runprms->nSites + 1));
+    memcpy (oldOffset, runprms->edgeOffset,
+            sizeof (long) * (runprms->nSites + 1));
 
-        // remove softpairs
-        while (softpair)
+    // move the kept edges to the front
+    runprms->edgeOffset[0] = 0;
+    for (i = 0; i < runprms->nSites; ++i)
+    {
+        n = 0;
+        for (e = oldOffset[i]; e < oldOffset[i + 1]; ++e)
         {
-            // check if pair has been found twice. If so, skip it.
-            ignore = false;
-            while (temp)
-            {
-                if (softpair->i->index == temp->j->index &&
-                    softpair->j->index == temp->i->index &&
-                    softpair->j->index > temp->i->index)
-                    ignore = true;
-                temp = temp->next;
-            }
+            if (newPosition[e] < 0)
+                continue;
+
+            edge = &runprms->edges[e];
+            runprms->reverse[runprms->edgeOffset[i] + n] =
+                newPosition[oldOffset[edge->s] + runprms->reverse[e]];
+            runprms->edges[runprms->edgeOffset[i] + n] = *edge;
+            n++;
+        }
+        runprms->edgeOffset[i + 1] = runprms->edgeOffset[i] + n;
+        sites[i].nNeighbors = n;
+    }
 
-            // remove the softpair
-            if (!ignore)
-            {
-                rateb = 0;
-                rateab = 0;
+    runprms->edges = (SLE *) realloc (runprms->edges, sizeof (SLE) *
+                                      GSL_MAX (runprms->edgeOffset
+                                               [runprms->nSites], 1));
+    runprms->reverse = (int *) realloc (runprms->reverse, sizeof (int) *
+                                        GSL_MAX (runprms->edgeOffset
+                                                 [runprms->nSites], 1));
+    for (i = 0; i < runprms->nSites; ++i)
+        sites[i].neighbors = &runprms->edges[runprms->edgeOffset[i]];
 
-                // find the partner and elimintate the transition
-                for (i = 0; i < softpair->i->nNeighbors; ++i)
-                {
-                    if (softpair->j->index ==
-                        softpair->i->neighbors[i].s->index)
-                    {
-                        neighbor = &(softpair->i->neighbors[i]);
+    free (oldOffset);
+}
 
-                        rateab = neighbor->rate;
-                        rateb = neighbor->s->rateSum;
-                        neighbor->rate = 0.0;
-                        break;
-                    }
-                }
+/*
+ * Removes the softpairs, using the algorithm described in the PhD thesis
+ * of Fredrik Jansson. A softpair is an edge of site i to site j that
+ * carries more than prms->softpairthreshold of the rate of i, so that the
+ * carrier mostly oscillates between them. The edge is removed and the
+ * rates of i to the common neighbors x of both are merged with those of
+ * j: (r_ix R_j + r_jx r_ij) / (R_j + r_ij). This may create new
+ * softpairs, so it is repeated until there are none. Every iteration
+ * removes at least one edge, so it ends. Finally, the edges without rate
+ * in both directions are removed from the graph, except in a sweep,
+ * whose next point recalculates all the rates.
+ */
+void
+MC_removeSoftPairs (Site * sites, RunParams * runprms)
+{
+    Params *prms = runprms->prms;
+    int i, k, n, iteration = 0, nPairs = 0, *newPosition;
+    long e, r, nEdges = runprms->edgeOffset[runprms->nSites], *soft;
+    Softpair *pairs;
+    struct timeval start, end, result;
 
-                // update transition rates of all other neighbors
-                rateSum = 0.0;
-                for (i = 0; i < softpair->i->nNeighbors; ++i)
-                {
-                    neighbor = &(softpair->i->neighbors[i]);
+    soft = (long *) malloc (sizeof (long) * runprms->nSites);
+    pairs = (Softpair *) malloc (sizeof (Softpair) * runprms->nSites);
 
-                    // find the partner
-                    if (softpair->j->index != neighbor->s->index)
-                    {
-                        ratebx = 0.0;
-                        for (j = 0; j < softpair->j->nNeighbors; ++j)
-                        {
-                            if (softpair->j->neighbors[j].s->index ==
-                                neighbor->s->index)
-                                ratebx = ntemp->rate;
-                        }
-                        if (ratebx > 0)
-                        {
-                            neighbor->rate *= rateb;
-                            neighbor->rate += ratebx * rateab;
-                            neighbor->rate /= (rateb + rateab);
-                        }
-                        rateSum += neighbor->rate;
-                    }
-                }
-                softpair->i->rateSum = rateSum;
+    while (true)
+    {
+        gettimeofday (&start, NULL);
+        n = findSoftPairs (sites, runprms, soft, pairs);
+        if (n == 0)
+            break;
+        mergeSoftPairs (sites, runprms, pairs, n);
+        gettimeofday (&end, NULL);
+        timeval_subtract (&result, &start, &end);
+
+        iteration++;
+        nPairs += n;
+        output (prms, O_SERIAL,
+                "\tRemoving softpairs...: \tIteration %d: %d pairs, %f s\n",
+                iteration, n, result.tv_sec + result.tv_usec / 1e6);
+    }
+    free (soft);
+    free (pairs);
+
+    if (nPairs == 0)
+    {
+        output (prms, O_SERIAL, "\tRemoving softpairs...: \tNone found.\n");
+        return;
+    }
+
+    // remove the edges without rate in both directions
+    if (prms->npoints == 1)
+    {
+        newPosition = (int *) malloc (sizeof (int) * nEdges);
+#pragma omp parallel for private(k, n, e, r) schedule(dynamic, 1024) \
+    num_threads(runprms->nthreads)
+        for (i = 0; i < runprms->nSites; ++i)
+        {
+            for (k = 0, n = 0; k < sites[i].nNeighbors; ++k)
+            {
+                e = runprms->edgeOffset[i] + k;
+                r = runprms->edgeOffset[runprms->edges[e].s] +
+                    runprms->reverse[e];
+                newPosition[e] = -1;
+                if (runprms->edges[e].rate > 0 || runprms->edges[r].rate > 0)
+                    newPosition[e] = n++;
             }
-            softpair = softpair->next;
         }
+        compactEdges (sites, runprms, newPosition);
+        free (newPosition);
+    }
+
+    // the merged neighbor lists are sorted by rate again
+    sortNeighbors (sites, runprms, true);
+
+    output (prms, O_SERIAL,
+            "\tRemoving softpairs...: \tDone. %d pairs in %d iterations, "
+            "%ld of %ld edges kept.\n", nPairs, iteration,
+            runprms->edgeOffset[runprms->nSites], nEdges);
+}
+
+/*
+ * Finds the softpairs, at most one per site, its fastest soft edge, and
+ * stores them in pairs. soft is a buffer of one entry per site. If both
+ * directions of a pair are soft, only the one of the site with the lower
+ * index is kept. Returns the number of pairs.
+ */
+int
+findSoftPairs (Site * sites, RunParams * runprms, long *soft,
+               Softpair * pairs)
+{
+    Params *prms = runprms->prms;
+    int i, j, k, n = 0;
+    long e;
+    SLE *edges = runprms->edges;
 
-        // free memory
-        softpair = newSoftpair;
-        while (softpair)
+#pragma omp parallel for private(k, e) schedule(dynamic, 1024) \
+    num_threads(runprms->nthreads)
+    for (i = 0; i < runprms->nSites; ++i)
+    {
+        soft[i] = -1;
+        for (k = 0; k < sites[i].nNeighbors; ++k)
         {
-            temp = softpair->next;
-            free (softpair);
-            softpair = temp;
+            e = runprms->edgeOffset[i] + k;
+            if (edges[e].rate / sites[i].rateSum > prms->softpairthreshold &&
+                (soft[i] < 0 || edges[e].rate > edges[soft[i]].rate))
+                soft[i] = e;
         }
+    }
 
+    for (i = 0; i < runprms->nSites; ++i)
+    {
+        if (soft[i] < 0)
+            continue;
 
-        // all removed ?
-        int counter = 0;
-        for (j = 0; j < runprms->nSites; ++j)
-            for (i = 0; i < sites[j].nNeighbors; ++i)
-                if (sites[j].neighbors[i].rate / sites[j].rateSum >
-                    prms.softpairthreshold)
-                    counter++;
-
-        // some output
-        output (O_SERIAL, "\t\tDone. %d Softpairs found.\n", counter);
+        j = edges[soft[i]].s;
+        if (j < i && soft[j] == runprms->edgeOffset[j] +
+            runprms->reverse[soft[i]])
+            continue;
 
-        // recursive call if there are still softpairs
-        if (counter > 0)
-            MC_removeSoftPairs (sites, runprms);
+        pairs[n].i = i;
+        pairs[n].e = soft[i];
+        n++;
     }
+
+    return n;
 }
 
 /*
- * Returns a linked list of type SLE for the neighbors of the site
- * s. Requires the array of cells.
+ * Removes the n softpairs and merges the rates, see MC_removeSoftPairs().
+ * All new rates are calculated from the old ones first, so the result
+ * doesn't depend on the order of the pairs, and the pairs are
+ * independent of each other. The rates of the partner j are looked up by
+ * destination in a buffer of every thread.
  */
 void
-setNeighbors (Site * s, Cell * cells)
+mergeSoftPairs (Site * sites, RunParams * runprms, Softpair * pairs, int n)
 {
-    int i, k, l;
-    Cell *c;
-    ln *siteList;
-    Vector d;
-    double length;
+    int p, k;
+    long *offset;
+    float *merged, *partnerRate;
+    double rate, rateab, rateb, ratebx, rateSum;
+    Site *a, *b;
+    SLE *ab;
+
+    offset = (long *) malloc (sizeof (long) * (n + 1));
+    offset[0] = 0;
+    for (p = 0; p < n; ++p)
+        offset[p + 1] = offset[p] + sites[pairs[p].i].nNeighbors;
+    merged = (float *) malloc (sizeof (float) * GSL_MAX (offset[n], 1));
+
+#pragma omp parallel private(p, k, a, b, ab, rate, rateab, rateb, ratebx, \
+                             partnerRate) num_threads(runprms->nthreads)
+    {
+        partnerRate = (float *) calloc (runprms->nSites, sizeof (float));
 
-    ln *curr, *head = NULL, *tmp;
+#pragma omp for schedule(dynamic, 64)
+        for (p = 0; p < n; ++p)
+        {
+            a = &sites[pairs[p].i];
+            ab = &runprms->edges[pairs[p].e];
+            b = &sites[ab->s];
+            rateab = ab->rate;
+            rateb = b->rateSum;
 
-    // now, find all the neighbors
-    // iterate over all neighboring cells
-    for (i = -1; i <= 1; i++)
-        for (k = -1; k <= 1; k++)
-            for (l = -1; l <= 1; l++)
+            for (k = 0; k < b->nNeighbors; ++k)
+                partnerRate[b->neighbors[k].s] = b->neighbors[k].rate;
+
+            // the edge to the partner is eliminated, the others merged
+            for (k = 0; k < a->nNeighbors; ++k)
             {
+                rate = a->neighbors[k].rate;
+                ratebx = partnerRate[a->neighbors[k].s];
+                if (&a->neighbors[k] == ab)
+                    rate = 0.0;
+                else if (ratebx > 0)
+                    rate = (rate * rateb + ratebx * rateab) /
+                        (rateb + rateab);
+                merged[offset[p] + k] = rate;
+            }
 
-                c = getCell3D (cells, i + floor (s->x / prms.cutoff_radius),
-                               floor (k + s->y / prms.cutoff_radius),
-                               floor (l + s->z / prms.cutoff_radius));
-                siteList = c->siteList;
+            for (k = 0; k < b->nNeighbors; ++k)
+                partnerRate[b->neighbors[k].s] = 0.0;
+        }
 
-                while (siteList)
-                {
-                    // if this is not the same Site as s and
-                    // is within the cutoff radius, attach it 
-                    // to the neighbor list and count one up.
-                    d = distance (s, siteList->s);
-                    length =
-                        sqrt (pow (d.x, 2.) + pow (d.y, 2.) + pow (d.z, 2.));
-
-                    if (s->index != siteList->s->index &&
-                        length < prms.cutoff_radius)
-                    {
-                        curr = (ln *) malloc (sizeof (ln));
+        free (partnerRate);
+    }
+
+#pragma omp parallel for private(k, a, rateSum) schedule(dynamic, 64) \
+    num_threads(runprms->nthreads)
+    for (p = 0; p < n; ++p)
+    {
+        a = &sites[pairs[p].i];
+        rateSum = 0.0;
+        for (k = 0; k < a->nNeighbors; ++k)
+        {
+            a->neighbors[k].rate = merged[offset[p] + k];
+            rateSum += a->neighbors[k].rate;
+        }
+        a->rateSum = rateSum;
+    }
 
-                        s->nNeighbors++;
+    free (offset);
+    free (merged);
+}
 
-                        curr->dist = d;
-                        curr->s = siteList->s;
-                        curr->next = head;
-                        head = curr;
+/*
+ * This function builds the Walker alias table of every site using Vose's
+ * algorithm. With it, hoppingStep() selects the destination of a hop with
+ * a single random number and two memory reads, regardless of the number of
+ * neighbors. It has to be called after the rates are final, i.e., after
+ * MC_createHoppingRates() and MC_removeSoftPairs().
+ */
+void
+MC_createAliasTables (Site * sites, RunParams * runprms)
+{
+    int i, j, n, nSmall, nLarge, small, large, maxNeighbors = 0;
+    int *smallList, *largeList;
+    double *scaled;
+    Site *s;
 
-                    }
-                    siteList = siteList->next;
-                }
-            }
+    for (i = 0; i < runprms->nSites; ++i)
+        maxNeighbors = GSL_MAX (maxNeighbors, sites[i].nNeighbors);
 
-    // now make the neighbor array
-    curr = head;
-    s->neighbors = (SLE *) malloc (sizeof (SLE) * s->nNeighbors);
-    i = 0;
-    while (curr)
+    smallList = malloc (sizeof (int) * maxNeighbors);
+    largeList = malloc (sizeof (int) * maxNeighbors);
+    scaled = malloc (sizeof (double) * maxNeighbors);
+
+    // the tables are stored like the neighbor graph
+    free (runprms->aliasEntries);
+    runprms->aliasEntries = (AliasEntry *) malloc (sizeof (AliasEntry) *
+                                                   runprms->edgeOffset
+                                                   [runprms->nSites]);
+
+    for (i = 0; i < runprms->nSites; ++i)
     {
-        s->neighbors[i].s = curr->s;
-        s->neighbors[i].rate = calcHoppingRate (*s, *curr->s);
-        s->neighbors[i].dist = curr->dist;
-        s->neighbors[i].nTransitions = 0;
-        s->rateSum += s->neighbors[i].rate;
+        s = &sites[i];
+        n = s->nNeighbors;
+
+        s->aliasTable = &runprms->aliasEntries[runprms->edgeOffset[i]];
+
+        // scale the probabilities so that their mean is one and sort them
+        // into the two work lists
+        nSmall = 0;
+        nLarge = 0;
+        for (j = 0; j < n; ++j)
+        {
+            scaled[j] = (s->rateSum > 0) ? s->neighbors[j].rate * n / s->rateSum : 1.0;
+            if (scaled[j] < 1.0)
+                smallList[nSmall++] = j;
+            else
+                largeList[nLarge++] = j;
+        }
+
+        // pair every small entry with a large one
+        while (nSmall > 0 && nLarge > 0)
+        {
+            small = smallList[--nSmall];
+            large = largeList[--nLarge];
+
+            s->aliasTable[small].prob = scaled[small];
+            s->aliasTable[small].alias = large;
 
-        curr = curr->next;
-        ++i;
+            scaled[large] += scaled[small] - 1.0;
+            if (scaled[large] < 1.0)
+                smallList[nSmall++] = large;
+            else
+                largeList[nLarge++] = large;
+        }
+
+        // the remaining entries are (up to rounding errors) exactly one
+        while (nLarge > 0)
+        {
+            large = largeList[--nLarge];
+            s->aliasTable[large].prob = 1.0;
+            s->aliasTable[large].alias = large;
+        }
+        while (nSmall > 0)
+        {
+            small = smallList[--nSmall];
+            s->aliasTable[small].prob = 1.0;
+            s->aliasTable[small].alias = small;
+        }
     }
 
-    // free the temporary list
-    curr = head;
-    while (curr)
+    free (smallList);
+    free (largeList);
+    free (scaled);
+}
+
+/*
+ * Prepares the sites for the rejection-free mode. The neighbors of a site
+ * are sorted by rate, and the first nStrong of them make up the fraction
+ * STRONG_RATE_MASS of the total rate. Only their occupation is tracked
+ * exactly, hops to the remaining weak neighbors are still attempted and
+ * may fail. For every site, the list of transitions into it from sites
+ * that have it as a strong neighbor is stored in runprms->inEdges, so that a
+ * change of its occupation reaches exactly the carriers it affects. The
+ * lists are filled with a counting sort over the destinations.
+ */
+void
+MC_createIncomingEdges (Site * sites, RunParams * runprms)
+{
+    int i, j, k, n = runprms->nSites;
+    double rateSum;
+    int *fill;
+    Site *s;
+
+    free (runprms->inOffset);
+    free (runprms->rateSumWeak);
+    runprms->inOffset = (int *) calloc (n + 1, sizeof (int));
+    runprms->rateSumWeak = (double *) malloc (sizeof (double) * n);
+
+    for (i = 0; i < n; ++i)
     {
-        tmp = curr->next;
-        free (curr);
-        curr = tmp;
+        s = &sites[i];
+
+        rateSum = 0.0;
+        for (k = 0; k < s->nNeighbors &&
+             rateSum < STRONG_RATE_MASS * s->rateSum; ++k)
+            rateSum += s->neighbors[k].rate;
+
+        s->nStrong = k;
+        runprms->rateSumWeak[i] = 0.0;
+        for (; k < s->nNeighbors; ++k)
+            runprms->rateSumWeak[i] += s->neighbors[k].rate;
+
+        for (k = 0; k < s->nStrong; ++k)
+            runprms->inOffset[s->neighbors[k].s + 1]++;
     }
 
-    // sort the neighbors according to the rate to save computation
-    // time while simulating
-    qsort (s->neighbors, s->nNeighbors, sizeof (SLE), compare_neighbors);
+    for (i = 0; i < n; ++i)
+        runprms->inOffset[i + 1] += runprms->inOffset[i];
+
+    free (runprms->inEdges);
+    runprms->inEdges =
+        (InEdge *) malloc (sizeof (InEdge) * GSL_MAX (runprms->inOffset[n], 1));
+    fill = (int *) malloc (sizeof (int) * n);
+    memcpy (fill, runprms->inOffset, sizeof (int) * n);
+
+    for (i = 0; i < n; ++i)
+        for (k = 0; k < sites[i].nStrong; ++k)
+        {
+            j = sites[i].neighbors[k].s;
+            runprms->inEdges[fill[j]].s = &sites[i];
+            runprms->inEdges[fill[j]].rate = sites[i].neighbors[k].rate;
+            fill[j]++;
+        }
+
+    free (fill);
 }
 
 /*
- * This function calculates the hopping rate from one site to another. It
- * takes into account periodic boundary con- ditions. float instead of
- * double to save memory.
+ * Allocates the statistics of the sites in runprms->stats. The visit
+ * counters are only needed for the output of the sites, and tempOccTime
+ * only when the reruns are simulated one after the other. The transition
+ * counters need the neighbor graph.
  */
-double
-calcHoppingRate (Site i, Site j)
+void
+MC_createSiteStats (RunParams * runprms)
 {
-    double r = 1.0;
-    float dE, dist;
-    Vector distances;
+    Params *prms = runprms->prms;
+    SiteStats *st = &runprms->stats;
 
-    // calc spatial and energetic distances
-    distances = distance (&i, &j);
-    dE = j.energy - i.energy - prms.field * distances.z;
-    dist = sqrt (pow (distances.x, 2.0) +
-                 pow (distances.y, 2.0) + pow (distances.z, 2.0));
+    st->totalOccTime = (float *) calloc (runprms->nSites, sizeof (float));
+    st->tempOccTime = NULL;
+    st->visited = NULL;
+    st->visitedUpward = NULL;
+    st->transitions = NULL;
 
-    // spatial part
-    r *= exp (-2.0 * dist / prms.loclength);
+    if (!prms->parallelreruns)
+        st->tempOccTime = (float *) calloc (runprms->nSites, sizeof (float));
 
-    // energy part
-    if (dE > 0 && prms.temperature > 0)
-        r *= exp (-1.0 * dE / prms.temperature);
-    if (dE > 0 && prms.temperature == 0)
-        r = 0;
+    if (strArgGiven (prms->output_folder))
+    {
+        st->visited =
+            (unsigned int *) calloc (runprms->nSites, sizeof (unsigned int));
+        st->visitedUpward =
+            (unsigned int *) calloc (runprms->nSites, sizeof (unsigned int));
+    }
 
-    return r;
+    if (strArgGiven (prms->output_folder) && prms->output_transitions)
+        st->transitions =
+            (unsigned int *) calloc (runprms->edgeOffset[runprms->nSites],
+                                     sizeof (unsigned int));
 }
 
+/*
+ * Collects the cells next to cell c, which come after it in the cell
+ * order, into forward and returns their number. Together with the
+ * following sites in the cell itself, they hold the pair partners of its
+ * sites, so that every pair is found once. A neighbor, which is reached
+ * through several periodic images in small samples, is only counted once.
+ */
+int
+forwardCells (Cells * cells, int c, RunParams * runprms, int *forward)
+{
+    Params *prms = runprms->prms;
+    int i, k, l, m, d, n = 0;
+    Vector *pos;
+    double x, y, z;
+
+    // empty cells don't have pairs
+    if (cells->first[c] == cells->first[c + 1])
+        return 0;
+
+    pos = &runprms->positions[cells->sites[cells->first[c]]];
+    x = floor (pos->x / prms->cutoff_radius);
+    y = floor (pos->y / prms->cutoff_radius);
+    z = floor (pos->z / prms->cutoff_radius);
+
+    for (i = -1; i <= 1; i++)
+        for (k = -1; k <= 1; k++)
+            for (l = -1; l <= 1; l++)
+            {
+                d = getCell3D (i + x, k + y, l + z, prms);
+                if (d <= c)
+                    continue;
+
+                for (m = 0; m < n && forward[m] != d; ++m);
+                if (m == n)
+                    forward[n++] = d;
+            }
+
+    return n;
+}
 
 /*
- * This function calculates the distance between two sites and takes into
- * account periodic boundary conditions. It returns a Vector struct with
- * the fields x,y and z.
+ * Finds the pair partners of the site at position p in the cell arrays,
+ * which lies in cell c: the following sites in c and the sites in the
+ * nForward cells forward (see forwardCells()), within the cut-off
+ * radius. Returns their number, cand holds their positions and
+ * displacements. If rates is true, the hopping rates to them and back are
+ * calculated too, for the temperature and field in runprms.
+ *
+ * The candidates from each cell are processed in vectorized loops: the
+ * periodic boundary conditions are applied without branches, the
+ * candidates are compared with the squared cut-off radius, and the
+ * Miller-Abrahams rate
+ *
+ *     exp (-2 d / a - max (dE, 0) / T)
+ *
+ * is calculated with a single exponential per direction.
  */
-Vector
-distance (Site * i, Site * j)
+int
+findPairs (Cells * cells, int c, int p, int *forward, int nForward,
+           Candidates * cand, bool rates, RunParams * runprms)
 {
-    float lx, ly, lz;
-    Vector vec;
+    Params *prms = runprms->prms;
+    int i, j, d, first, last, m = 0, n = 0;
+    float x = cells->x[p], y = cells->y[p], z = cells->z[p], dx, dy, dz, dE;
+    float lx = prms->length_x, ly = prms->length_y, lz = prms->length_z;
+    float rc2 = prms->cutoff_radius * prms->cutoff_radius;
+    float energy = cells->energy[p], field = runprms->field;
+    double spatial, invLoclength = 1.0 / runprms->loclength;
+    double invTemperature =
+        (runprms->temperature > 0) ? 1.0 / runprms->temperature : 0;
+    bool zeroTemperature = (runprms->temperature == 0);
+
+    // collect the candidates of the cell itself and the forward cells
+    for (i = -1; i < nForward; i++)
+    {
+        d = (i < 0) ? c : forward[i];
+        first = (i < 0) ? p + 1 : cells->first[d];
+        last = cells->first[d + 1];
+
+#pragma omp simd private(dx, dy, dz)
+        for (j = first; j < last; ++j)
+        {
+            dx = cells->x[j] - x;
+            dy = cells->y[j] - y;
+            dz = cells->z[j] - z;
+            dx -= lx * rintf (dx / lx);
+            dy -= ly * rintf (dy / ly);
+            dz -= lz * rintf (dz / lz);
+
+            cand->j[m + j - first] = j;
+            cand->dx[m + j - first] = dx;
+            cand->dy[m + j - first] = dy;
+            cand->dz[m + j - first] = dz;
+            cand->d2[m + j - first] = dx * dx + dy * dy + dz * dz;
+            cand->energy[m + j - first] = cells->energy[j];
+        }
+        m += last - first;
+    }
+
+    // keep the ones within the cut-off radius
+    for (j = 0; j < m; ++j)
+    {
+        if (cand->d2[j] >= rc2)
+            continue;
+
+        cand->j[n] = cand->j[j];
+        cand->dx[n] = cand->dx[j];
+        cand->dy[n] = cand->dy[j];
+        cand->dz[n] = cand->dz[j];
+        cand->d2[n] = cand->d2[j];
+        cand->energy[n] = cand->energy[j];
+        n++;
+    }
 
-    lx = prms.length_x / 2.;
-    ly = prms.length_y / 2.;
-    lz = prms.length_z / 2.;
+    if (!rates)
+        return n;
 
-    vec.x = j->x - i->x;
-    vec.y = j->y - i->y;
-    vec.z = j->z - i->z;
+    // the hopping rates in both directions, which share the spatial part.
+    // Only the one upwards in energy has a Boltzmann factor.
+#pragma omp simd private(dE, spatial)
+    for (j = 0; j < n; ++j)
+    {
+        dE = cand->energy[j] - energy - field * cand->dz[j];
+        spatial = -2.0 * sqrt (cand->d2[j]) * invLoclength;
+        cand->rate[j] = exp (spatial - ((dE > 0) ? dE * invTemperature : 0.0));
+        cand->rateBack[j] =
+            exp (spatial - ((dE < 0) ? -dE * invTemperature : 0.0));
+        if (zeroTemperature && dE > 0)
+            cand->rate[j] = 0.0;
+        if (zeroTemperature && dE < 0)
+            cand->rateBack[j] = 0.0;
+    }
 
-    if (vec.x > lx)
-        vec.x -= prms.length_x;
-    else if (vec.x < -lx)
-        vec.x += prms.length_x;
+    return n;
+}
 
-    if (vec.y > ly)
-        vec.y -= prms.length_y;
-    else if (vec.y < -ly)
-        vec.y += prms.length_y;
+/*
+ * Sorts the filled range s->neighbors of the neighbor graph by the
+ * hopping rates and sums them up. The positions of the reverse edges in
+ * runprms->reverse are moved along, newPosition receives where each
+ * neighbor went. sorted and copy are buffers for all the neighbors. If
+ * presorted is true, the range is almost in order already.
+ */
+void
+setNeighbors (Site * s, RunParams * runprms, NeighborEntry * sorted,
+              SLE * copy, int *newPosition, bool presorted)
+{
+    int i;
+    long offset = s->neighbors - runprms->edges;
+    union
+    {
+        float f;
+        unsigned int u;
+    } rate;
 
-    if (vec.z > lz)
-        vec.z -= prms.length_z;
-    else if (vec.z < -lz)
-        vec.z += prms.length_z;
+    // the bits of a non-negative float are ordered like its value, so
+    // the inverted ones sort the highest rate first
+    for (i = 0; i < s->nNeighbors; ++i)
+    {
+        copy[i] = s->neighbors[i];
+        rate.f = copy[i].rate;
+        sorted[i].key = ((unsigned long) ~rate.u << 32) | copy[i].s;
+        sorted[i].old = i;
+        sorted[i].reverse = runprms->reverse[offset + i];
+    }
 
-    return vec;
+    // sort the neighbors according to the rate to save computation
+    // time while simulating
+    if (presorted)
+        insertionSort (sorted, s->nNeighbors);
+    else
+        qsort (sorted, s->nNeighbors, sizeof (NeighborEntry),
+               compare_neighbors);
+
+    s->rateSum = 0.0;
+    for (i = 0; i < s->nNeighbors; ++i)
+    {
+        s->neighbors[i] = copy[sorted[i].old];
+        runprms->reverse[offset + i] = sorted[i].reverse;
+        newPosition[offset + sorted[i].old] = i;
+        s->rateSum += s->neighbors[i].rate;
+    }
 }
 
 
 /*
  * This function maps a 3D matrix for the cells of the sample to a 1D
  * array (or the other way round.). Expects coordinates of the cell (small
- * x,y,z) as well as the cell array.  Returns a pointer to the desired
- * cell element.
+ * x,y,z), which are wrapped periodically.  Returns the index of the
+ * desired cell.
  */
-Cell *
-getCell3D (Cell * cells, ssize_t x, ssize_t y, ssize_t z)
-{
-    while (x >= prms.nx)
-        x -= prms.nx;
-    while (y >= prms.ny)
-        y -= prms.ny;
-    while (z >= prms.nz)
-        z -= prms.nz;
+int
+getCell3D (ssize_t x, ssize_t y, ssize_t z, Params * prms)
+{
+    while (x >= prms->nx)
+        x -= prms->nx;
+    while (y >= prms->ny)
+        y -= prms->ny;
+    while (z >= prms->nz)
+        z -= prms->nz;
     while (x < 0)
-        x += prms.nx;
+        x += prms->nx;
     while (y < 0)
-        y += prms.ny;
+        y += prms->ny;
     while (z < 0)
-        z += prms.nz;
+        z += prms->nz;
+
+    return (x * prms->nx + y) * prms->nz + z;
+}
+
+/*
+ * Sorts the n neighbors in a by their keys, like compare_neighbors(). It
+ * takes O(n) steps, if they are almost in order.
+ */
+void
+insertionSort (NeighborEntry * a, int n)
+{
+    int i, j;
+    NeighborEntry t;
 
-    return &cells[(x * prms.nx + y) * prms.nz + z];
+    for (i = 1; i < n; ++i)
+    {
+        t = a[i];
+        for (j = i; j > 0 && a[j - 1].key > t.key; --j)
+            a[j] = a[j - 1];
+        a[j] = t;
+    }
 }
 
 /*
- * Compare two neighbors by their rates
+ * Compare two neighbors by their rates, then by their index
  */
 int
 compare_neighbors (const void *a, const void *b)
 {
-    double diff = (((SLE *) a)->rate - ((SLE *) b)->rate);
-    return diff < 0 ? 1 : (diff > 0) ? -1 : 0;
+    unsigned long ka = ((NeighborEntry *) a)->key;
+    unsigned long kb = ((NeighborEntry *) b)->key;
+    return ka < kb ? -1 : (ka > kb) ? 1 : 0;
+}
+
+/*
+ * Compare two sites by their position on the Morton curve
+ */
+int
+compare_morton (const void *a, const void *b)
+{
+    unsigned long ca = ((MortonKey *) a)->code, cb = ((MortonKey *) b)->code;
+    return ca < cb ? -1 : (ca > cb) ? 1 : 0;
 }
@@ -0,0 +1,196 @@
+/*
+ * hophop: Charge transport simulations in disordered systems
+ *
+ * Copyright (c) 2012-2018 Jan Oliver Oelerich <jan.oliver.oelerich@physik.uni-marburg.de>
+ * Copyright (c) 2012-2018 Disordered Many-Particle Physics Group, Philipps-Universität Marburg, Germany
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+*/
+
+
+
+#include "hop.h"
+
+int compare_stencil (const void *a, const void *b);
+
+/*
+ * The hopping rate along the stencil entry st, where dE is the energy
+ * difference of the two sites, for the temperature and field in runprms.
+ * It is the Miller-Abrahams rate of findPairs() in mc_init.c, in single
+ * precision like the rates of the neighbor lists. At T = 0, all hops
+ * upwards in energy are forbidden.
+ */
+static inline float
+latticeRate (const StencilEntry * st, float dE, const RunParams * runprms,
+             double invTemperature)
+{
+    dE -= runprms->field * st->dz;
+    if (dE <= 0)
+        return (float) st->spatial;
+    if (runprms->temperature == 0)
+        return 0.0;
+    return (float) (st->spatial * exp (-dE * invTemperature));
+}
+
+/*
+ * The index of the site at the lattice position (x, y, z), which is
+ * wrapped periodically. The offsets of the stencil are smaller than half
+ * the sample, so the coordinates are at most one sample size outside.
+ */
+static inline int
+latticeIndex (int x, int y, int z, Params * prms)
+{
+    int lx = prms->length_x, ly = prms->length_y, lz = prms->length_z;
+
+    x += (x < 0) ? lx : ((x >= lx) ? -lx : 0);
+    y += (y < 0) ? ly : ((y >= ly) ? -ly : 0);
+    z += (z < 0) ? lz : ((z >= lz) ? -lz : 0);
+
+    return (x * ly + y) * lz + z;
+}
+
+/*
+ * Sets up the implicit lattice (--implicitlattice). All sites of a
+ * lattice have the same neighbors relative to their position, so instead
+ * of the neighbor graph, only the offsets within the cut-off radius and
+ * their spatial factors are stored in runprms->stencil, sorted by
+ * distance. The positions of the sites follow from their index, see
+ * initSite(). The rates are calculated from the site energies whenever a
+ * carrier hops, only their sums are stored in the sites.
+ */
+void
+MC_createStencil (Site * sites, RunParams * runprms)
+{
+    Params *prms = runprms->prms;
+    int i, j, k, dx, dy, dz, x, y, z, r = (int) prms->cutoff_radius;
+    float d2, rc2 = prms->cutoff_radius * prms->cutoff_radius;
+    double invLoclength = 1.0 / runprms->loclength;
+    double invTemperature =
+        (runprms->temperature > 0) ? 1.0 / runprms->temperature : 0;
+    double rateSum;
+    StencilEntry *st;
+
+    free (runprms->stencil);
+    runprms->stencil =
+        (StencilEntry *) malloc (sizeof (StencilEntry) * (2 * r + 1) *
+                                 (2 * r + 1) * (2 * r + 1));
+    runprms->nStencil = 0;
+
+    for (dx = -r; dx <= r; ++dx)
+        for (dy = -r; dy <= r; ++dy)
+            for (dz = -r; dz <= r; ++dz)
+            {
+                d2 = dx * dx + dy * dy + dz * dz;
+                if (d2 == 0 || d2 >= rc2)
+                    continue;
+
+                st = &runprms->stencil[runprms->nStencil++];
+                st->spatial = exp (-2.0 * sqrt (d2) * invLoclength);
+                st->dx = dx;
+                st->dy = dy;
+                st->dz = dz;
+                st->dist[0] = lround (dx / prms->dist_unit);
+                st->dist[1] = lround (dy / prms->dist_unit);
+                st->dist[2] = lround (dz / prms->dist_unit);
+            }
+
+    // the nearest neighbors first, they are the most likely destinations
+    qsort (runprms->stencil, runprms->nStencil, sizeof (StencilEntry),
+           compare_stencil);
+
+    // the rate sums of all sites
+#pragma omp parallel for private(j, k, x, y, z, rateSum, st) schedule(static) \
+    num_threads(runprms->nthreads)
+    for (i = 0; i < runprms->nSites; ++i)
+    {
+        x = i / (prms->length_y * prms->length_z);
+        y = (i / prms->length_z) % prms->length_y;
+        z = i % prms->length_z;
+
+        rateSum = 0.0;
+        for (k = 0; k < runprms->nStencil; ++k)
+        {
+            st = &runprms->stencil[k];
+            j = latticeIndex (x + st->dx, y + st->dy, z + st->dz, prms);
+            rateSum += latticeRate (st, sites[j].energy - sites[i].energy,
+                                    runprms, invTemperature);
+        }
+
+        sites[i].rateSum = rateSum;
+        sites[i].nNeighbors = runprms->nStencil;
+    }
+
+    output (prms, O_SERIAL,
+            "\tInitializing...: \t\tDone. %d neighbors per site.\n",
+            runprms->nStencil);
+}
+
+/*
+ * The implicit lattice's replacement of the scan over the neighbor list
+ * of site s: the rates along the stencil are summed up until they exceed
+ * randomHopProb. The neighbor list entry of the destination is assembled
+ * in e, which is returned.
+ */
+SLE *
+MC_latticeNeighbor (Site * s, double randomHopProb, RunParams * runprms,
+                    SLE * e)
+{
+    Params *prms = runprms->prms;
+    int k, j = s->index;
+    int x = j / (prms->length_y * prms->length_z);
+    int y = (j / prms->length_z) % prms->length_y;
+    int z = j % prms->length_z;
+    double invTemperature =
+        (runprms->temperature > 0) ? 1.0 / runprms->temperature : 0;
+    double probSum = 0.0;
+    float rate = 0.0;
+    Site *sites = runprms->sites;
+    StencilEntry *st = runprms->stencil;
+
+    for (k = 0; k < runprms->nStencil && probSum <= randomHopProb; ++k)
+    {
+        st = &runprms->stencil[k];
+        j = latticeIndex (x + st->dx, y + st->dy, z + st->dz, prms);
+        rate = latticeRate (st, sites[j].energy - s->energy, runprms,
+                            invTemperature);
+        probSum += rate;
+    }
+
+    e->s = j;
+    e->rate = rate;
+    e->dist[0] = st->dist[0];
+    e->dist[1] = st->dist[1];
+    e->dist[2] = st->dist[2];
+
+    return e;
+}
+
+/*
+ * Compare two stencil entries by their distance, then by their offset
+ */
+int
+compare_stencil (const void *a, const void *b)
+{
+    const StencilEntry *sa = (const StencilEntry *) a;
+    const StencilEntry *sb = (const StencilEntry *) b;
+
+    if (sa->spatial != sb->spatial)
+        return sa->spatial > sb->spatial ? -1 : 1;
+    if (sa->dx != sb->dx)
+        return sa->dx < sb->dx ? -1 : 1;
+    if (sa->dy != sb->dy)
+        return sa->dy < sb->dy ? -1 : 1;
+    return (sa->dz > sb->dz) - (sa->dz < sb->dz);
+}
@@ -0,0 +1,379 @@
+/*
+ * hophop: Charge transport simulations in disordered systems
+ *
+ * Copyright (c) 2012-2018 Jan Oliver Oelerich <jan.oliver.oelerich@physik.uni-marburg.de>
+ * Copyright (c) 2012-2018 Disordered Many-Particle Physics Group, Philipps-Universität Marburg, Germany
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+*/
+
+
+#include "hop.h"
+
+// a walker that is advanced in two stages. In the first one, its current
+// site is in the cache and the memory of the next hop is prefetched, in
+// the second one, the hop is executed.
+typedef struct walker
+{
+    Carrier *c;
+    RunParams *w;
+    double arrival;
+    double randomHopProb;
+    float originEnergy;
+    bool prepared;
+    bool arrived;
+} Walker;
+
+void walkerGroup (Site * sites, Carrier * carriers, RunParams * w, int n,
+                  SiteStats * st);
+void interleavedHops (Walker * walkers, int n, SiteStats * st, long nHops,
+                      bool stat);
+void walkerPrepare (Walker * k, SiteStats * st, bool stat);
+void walkerHop (Walker * k, SiteStats * st, bool stat);
+void walkerArrive (Walker * k, SiteStats * st);
+
+/*
+ * Runs the reruns of one realization as independent meanfield walkers in
+ * parallel (--parallelreruns). The sites and neighbor lists are only read,
+ * so all threads share them. Every walker has its own random number
+ * stream, carrier and time, every thread its own site statistics. Walker
+ * i corresponds to the rerun i + 1 of MC_run(). Each thread advances
+ * groups of prms->interleave walkers round-robin to hide the memory
+ * latency of the hops. The carrier and time results are reduced in the
+ * order of the walkers, so they depend neither on the number of threads
+ * nor on the interleaving.
+ */
+void
+MC_runWalkers (Site * sites, Carrier * carriers, RunParams * runprms)
+{
+    Params *prms = runprms->prms;
+    int i, j;
+    int nWalkers = prms->number_reruns;
+    int nGroups = (nWalkers + prms->interleave - 1) / prms->interleave;
+    Carrier *walkers = (Carrier *) malloc (sizeof (Carrier) * nWalkers);
+    RunParams *w = (RunParams *) malloc (sizeof (RunParams) * nWalkers);
+    unsigned long seed;
+    struct timeval start, end, result;
+    double elapsed;
+
+    // set up the walkers. Without counter-based streams, their seeds are
+    // drawn from the generator of the run.
+    for (i = 0; i < nWalkers; ++i)
+    {
+        walkers[i] = carriers[0];
+
+        w[i] = *runprms;
+        w[i].r = gsl_rng_alloc (prms->T);
+        seed = gsl_rng_get (runprms->r);
+        if (prms->counterrng)
+            RNG_setStream (w[i].r, runprms->rseed_used, runprms->iRun,
+                           runprms->iPoint * nWalkers + i + 1,
+                           RNG_STREAM_HOPPING);
+        else
+            gsl_rng_set (w[i].r, seed);
+        w[i].rng = NULL;
+        w[i].queue = NULL;
+        w[i].simulationTime = 0.0;
+        w[i].nHops = 0;
+    }
+
+    output (prms, O_SERIAL,
+            "\tSimulating %d walkers on %d threads (%d interleaved)...",
+            nWalkers, runprms->nthreads, prms->interleave);
+    fflush (stdout);
+    gettimeofday (&start, NULL);
+
+#pragma omp parallel private(i, j) num_threads(runprms->nthreads)
+    {
+        // the statistics of this thread. The visit counters are only
+        // collected when the run has them.
+        SiteStats st = { NULL };
+
+        st.totalOccTime = calloc (runprms->nSites, sizeof (float));
+        if (runprms->stats.visited != NULL)
+        {
+            st.visited = calloc (runprms->nSites, sizeof (unsigned int));
+            st.visitedUpward = calloc (runprms->nSites, sizeof (unsigned int));
+        }
+
+#pragma omp for schedule(dynamic)
+        for (i = 0; i < nGroups; ++i)
+        {
+            j = i * prms->interleave;
+            walkerGroup (sites, &walkers[j], &w[j],
+                         GSL_MIN (prms->interleave, nWalkers - j), &st);
+        }
+
+        // add the statistics of this thread to the ones of the run
+#pragma omp critical
+        for (j = 0; j < runprms->nSites; ++j)
+        {
+            runprms->stats.totalOccTime[j] += st.totalOccTime[j];
+            if (st.visited == NULL)
+                continue;
+            runprms->stats.visited[j] += st.visited[j];
+            runprms->stats.visitedUpward[j] += st.visitedUpward[j];
+        }
+
+        free (st.visited);
+        free (st.visitedUpward);
+        free (st.totalOccTime);
+    }
+
+    gettimeofday (&end, NULL);
+    timeval_subtract (&result, &start, &end);
+    elapsed = result.tv_sec + (double) result.tv_usec / 1e6;
+    output (prms, O_SERIAL, " Done. %lu hops/sec\n",
+            (size_t) (nWalkers * (prms->relaxation + prms->simulation) /
+                      elapsed));
+
+    // reduce the walkers into the carrier of the run, just like the
+    // sequential reruns accumulate into it
+    for (i = 0; i < nWalkers; ++i)
+    {
+        carriers[0].dx += walkers[i].dx;
+        carriers[0].dy += walkers[i].dy;
+        carriers[0].dz += walkers[i].dz;
+        carriers[0].dx2 += walkers[i].dx2;
+        carriers[0].dy2 += walkers[i].dy2;
+        carriers[0].dz2 += walkers[i].dz2;
+        carriers[0].site = walkers[i].site;
+
+        runprms->simulationTime += w[i].simulationTime;
+        runprms->nHops = w[i].nHops;
+
+        gsl_rng_free (w[i].r);
+    }
+
+    free (walkers);
+    free (w);
+}
+
+/*
+ * Relaxation and simulation of a group of n walkers, the equivalent of
+ * MC_distributeCarriers() and MC_simulation() for single carriers that
+ * leave the sites untouched. The time of every walker starts at zero with
+ * the simulation.
+ */
+void
+walkerGroup (Site * sites, Carrier * carriers, RunParams * w, int n,
+             SiteStats * st)
+{
+    Params *prms = w->prms;
+    int i;
+    Walker *walkers = (Walker *) malloc (sizeof (Walker) * n);
+
+    for (i = 0; i < n; ++i)
+    {
+        if (prms->fastrng)
+            w[i].rng = RNG_create (w[i].r);
+
+        walkers[i].c = &carriers[i];
+        walkers[i].w = &w[i];
+        walkers[i].prepared = false;
+        walkers[i].arrived = false;
+
+        carriers[i].site = &sites[gsl_rng_uniform_int (w[i].r, w[i].nSites)];
+        carriers[i].occTime = 0.0;
+        carriers[i].ddx = 0.0;
+        carriers[i].ddy = 0.0;
+        carriers[i].ddz = 0.0;
+    }
+
+    // relaxation, no time or hop counting
+    interleavedHops (walkers, n, st, prms->relaxation, false);
+
+    // actual simulation, time and hop counting
+    for (i = 0; i < n; ++i)
+    {
+        carriers[i].occTime -= w[i].simulationTime;
+        w[i].simulationTime = 0.0;
+        w[i].nHops = 0;
+        walkers[i].arrival = 0.0;
+    }
+    interleavedHops (walkers, n, st, prms->simulation + 1, true);
+
+    // finish statistics
+    for (i = 0; i < n; ++i)
+    {
+        if (walkers[i].arrived)
+            walkerArrive (&walkers[i], st);
+        st->totalOccTime[carriers[i].site->index] +=
+            w[i].simulationTime - walkers[i].arrival;
+
+        carriers[i].dx2 += pow (carriers[i].ddx, 2.0);
+        carriers[i].dy2 += pow (carriers[i].ddy, 2.0);
+        carriers[i].dz2 += pow (carriers[i].ddz, 2.0);
+
+        RNG_free (w[i].rng);
+        w[i].rng = NULL;
+    }
+
+    free (walkers);
+}
+
+/*
+ * Advances the n walkers round-robin, until each of them did nHops hops.
+ * Between the two stages of a hop of one walker, the other walkers do
+ * one stage each, so the prefetched memory has time to arrive.
+ */
+void
+interleavedHops (Walker * walkers, int n, SiteStats * st, long nHops,
+                 bool stat)
+{
+    int i, active = n;
+
+    while (active > 0)
+    {
+        active = 0;
+        for (i = 0; i < n; ++i)
+        {
+            if (walkers[i].prepared)
+                walkerHop (&walkers[i], st, stat);
+            else if (walkers[i].w->nHops < nHops)
+                walkerPrepare (&walkers[i], st, stat);
+            else
+                continue;
+
+            active++;
+        }
+    }
+}
+
+/*
+ * The first stage of a hop. The current site of the walker is in the
+ * cache now. The visit of the site is counted, the waiting time and the
+ * random number for the destination are drawn, and the part of the
+ * neighbor list that is most likely needed is prefetched.
+ */
+void
+walkerPrepare (Walker * k, SiteStats * st, bool stat)
+{
+    Params *prms = k->w->prms;
+    Site *s = k->c->site;
+    int i;
+
+    if (k->arrived)
+        walkerArrive (k, st);
+
+    k->c->occTime += (float) RNG_exponential (k->w) / s->rateSum;
+
+    if (prms->alias)
+    {
+        k->randomHopProb = RNG_uniform (k->w) * s->nNeighbors;
+        i = (int) k->randomHopProb;
+        __builtin_prefetch (&s->aliasTable[i]);
+        __builtin_prefetch (&s->neighbors[i]);
+    }
+    else
+    {
+        // the neighbors are sorted by rate, the destination is most
+        // likely among the first ones
+        k->randomHopProb = (float) RNG_uniform (k->w) * s->rateSum;
+        for (i = 0; i < 4 && s->neighbors != NULL; ++i)
+            __builtin_prefetch ((char *) s->neighbors + 64 * i);
+    }
+
+    if (stat)
+        __builtin_prefetch (&st->totalOccTime[s->index], 1);
+
+    k->prepared = true;
+}
+
+/*
+ * The second stage: the destination is selected and the walker hops. The
+ * destination site is prefetched for the next first stage. Its visit is
+ * counted there, because its energy and index are not in the cache yet.
+ */
+void
+walkerHop (Walker * k, SiteStats * st, bool stat)
+{
+    Params *prms = k->w->prms;
+    Carrier *c = k->c;
+    Site *orig = c->site, *to;
+    SLE *dest = NULL, latticeDest;
+    Vector dist;
+    double probSum;
+    int i;
+
+    if (prms->implicitlattice)
+    {
+        dest = MC_latticeNeighbor (orig, k->randomHopProb, k->w,
+                                   &latticeDest);
+    }
+    else if (prms->alias)
+    {
+        i = (int) k->randomHopProb;
+        if (k->randomHopProb - i < orig->aliasTable[i].prob)
+            dest = &(orig->neighbors[i]);
+        else
+            dest = &(orig->neighbors[orig->aliasTable[i].alias]);
+    }
+    else
+    {
+        probSum = 0.0;
+        for (i = 0; ((i < orig->nNeighbors) && (probSum <= k->randomHopProb));
+             ++i)
+        {
+            dest = &(orig->neighbors[i]);
+            probSum += dest->rate;
+        }
+    }
+
+    to = &k->w->sites[dest->s];
+    __builtin_prefetch (to);
+    __builtin_prefetch ((char *) to + sizeof (Site) - 1);
+
+    k->w->simulationTime = c->occTime;
+    k->w->nHops++;
+
+    if (stat)
+    {
+        st->totalOccTime[orig->index] += k->w->simulationTime - k->arrival;
+        k->arrival = k->w->simulationTime;
+        k->originEnergy = orig->energy;
+        k->arrived = true;
+
+        dist = SLE_dist (dest, k->w);
+        c->dx += dist.x;
+        c->dy += dist.y;
+        c->dz += dist.z;
+
+        c->ddx += dist.x;
+        c->ddy += dist.y;
+        c->ddz += dist.z;
+    }
+
+    c->site = to;
+    k->prepared = false;
+}
+
+/*
+ * Counts the visit of the current site of the walker.
+ */
+void
+walkerArrive (Walker * k, SiteStats * st)
+{
+    Site *s = k->c->site;
+
+    if (st->visited == NULL)
+        return;
+    if (k->originEnergy < s->energy)
+        st->visitedUpward[s->index]++;
+    else
+        st->visited[s->index]++;
+
+    k->arrived = false;
+}
@@ -24,6 +24,8 @@
 #include "hop.h"
 
 void checkOutputFolder (RunParams * runprms);
+void realizationFolder (char *folder, RunParams * runprms);
+int *sitePositions (RunParams * runprms);
 void get_timestring (char** timestringm, time_t t);
 void get_timestring_now(char ** timestring);
 
@@ -39,27 +41,46 @@ void get_timestring_now(char ** timestring);
 void
 writeSites (Site * sites, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     checkOutputFolder (runprms);
 
     FILE *file;
     int i;
-    char fileName[128] = "";
+    char fileName[256] = "";
+    int *position = sitePositions (runprms);
+    SiteStats *st = &runprms->stats;
+    Vector pos;
+    Site *s;
 
-    sprintf (fileName, "%s/%d/sites.dat", prms.output_folder, runprms->iRun);
+    realizationFolder (fileName, runprms);
+    strcat (fileName, "/sites.dat");
 
     file = fopen (fileName, "w+");
 
-    // write site information
-    for (i = 0; i < prms.nsites; ++i)
+    // write site information in the original order
+    for (i = 0; i < runprms->nSites; ++i)
     {
-        fprintf (file, "%8.5f %8.5f %8.5f %8.5f %8lu %8lu\n",
-                 sites[i].x, sites[i].y, sites[i].z,
-                 sites[i].energy, sites[i].visited, sites[i].visitedUpward);
+        s = &sites[position[i]];
+        if (runprms->positions != NULL)
+            pos = runprms->positions[position[i]];
+        else
+        {
+            // the implicit lattice, see initSite()
+            pos.x = i / (prms->length_y * prms->length_z);
+            pos.y = (i / prms->length_z) % prms->length_y;
+            pos.z = i % prms->length_z;
+        }
+        fprintf (file, "%8.5f %8.5f %8.5f %8.5f %8u %8u\n",
+                 pos.x, pos.y, pos.z, s->energy,
+                 st->visited ? st->visited[position[i]] : 0,
+                 st->visitedUpward ? st->visitedUpward[position[i]] : 0);
     }
     fclose (file);
+    free (position);
 
     // some output
-    output (O_SERIAL, "\tWrote site result information to \t%s\n", fileName);
+    output (prms, O_SERIAL,
+            "\tWrote site result information to \t%s\n", fileName);
 }
 
 
@@ -70,40 +91,66 @@ writeSites (Site * sites, RunParams * runprms)
 void
 writeTransitions (Site * sites, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     checkOutputFolder (runprms);
 
     FILE *file;
     int i, j;
-    char fileName[128] = "";
+    char fileName[256] = "";
     SLE *neighbor;
+    int *position = sitePositions (runprms);
+    int *order = runprms->siteOrder;
+    SiteStats *st = &runprms->stats;
+    unsigned int n;
+    Site *s;
 
-    sprintf (fileName, "%s/%d/transitions.dat", prms.output_folder,
-             runprms->iRun);
+    realizationFolder (fileName, runprms);
+    strcat (fileName, "/transitions.dat");
 
     file = fopen (fileName, "w+");
 
-    // write transitions information
-    for (i = 0; i < prms.nsites; ++i)
+    // write transitions information with the original site indices
+    for (i = 0; i < runprms->nSites && st->transitions != NULL; ++i)
     {
-        for (j = 0; j < sites[i].nNeighbors; ++j)
+        s = &sites[position[i]];
+        for (j = 0; j < s->nNeighbors; ++j)
         {
-            neighbor = &(sites[i].neighbors[j]);
-            if (neighbor->nTransitions > 0)
+            neighbor = &(s->neighbors[j]);
+            n = st->transitions[runprms->edgeOffset[s->index] + j];
+            if (n > 0)
             {
-                fprintf (file, "%d %d %8.5f %8.5f %8d\n",
-                         sites[i].index, neighbor->s->index, sites[i].energy,
-                         neighbor->s->energy, neighbor->nTransitions);
+                fprintf (file, "%d %d %8.5f %8.5f %8u\n", i,
+                         order ? order[neighbor->s] : neighbor->s, s->energy,
+                         sites[neighbor->s].energy, n);
             }
         }
 
     }
     fclose (file);
+    free (position);
 
     // some output
-    output (O_SERIAL, "\tWrote transitions information to \t%s\n", fileName);
+    output (prms, O_SERIAL,
+            "\tWrote transitions information to \t%s\n", fileName);
 }
 
 
+/*
+ * Returns the current position of every site, indexed by its original
+ * index. Without --reorder, this is the identity.
+ */
+int *
+sitePositions (RunParams * runprms)
+{
+    int i;
+    int *position = (int *) malloc (sizeof (int) * runprms->nSites);
+
+    for (i = 0; i < runprms->nSites; ++i)
+        position[runprms->siteOrder ? runprms->siteOrder[i] : i] = i;
+
+    return position;
+}
+
 /*
  * Writes the configuration file, which can be read by the program using
  * the option --conf_file=/path/to/params.conf to re-use the settings.
@@ -113,15 +160,17 @@ writeTransitions (Site * sites, RunParams * runprms)
 void
 writeConfig (RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     checkOutputFolder (runprms);
 
-    char fileName[128] = "";
+    char fileName[256] = "";
 
-    sprintf (fileName, "%s/params.conf", prms.output_folder);
-    cmdline_parser_file_save (fileName, prms.cmdlineargs);
+    sprintf (fileName, "%s/params.conf", prms->output_folder);
+    cmdline_parser_file_save (fileName, prms->cmdlineargs);
 
     // some output
-    output (O_SERIAL, "\tWrote configuration file to \t\t%s\n", fileName);
+    output (prms, O_SERIAL,
+            "\tWrote configuration file to \t\t%s\n", fileName);
 }
 
 /*
@@ -132,14 +181,15 @@ writeConfig (RunParams * runprms)
 void
 writeResults (Results * res, RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     checkOutputFolder (runprms);
 
     FILE *file, *file2;
-    char fileName[128] = "";
+    char fileName[256] = "";
     int buffer = 0;
 
-    sprintf (fileName, "%s/%d/results.dat", prms.output_folder,
-        runprms->iRun);
+    realizationFolder (fileName, runprms);
+    strcat (fileName, "/results.dat");
 
     // check for the header
     file2 = fopen (fileName, "r");
@@ -197,7 +247,7 @@ writeResults (Results * res, RunParams * runprms)
     fclose (file);
 
     // some output
-    output (O_SERIAL, "\n\tWrote results to \t\t\t%s\n", fileName);
+    output (prms, O_SERIAL, "\n\tWrote results to \t\t\t%s\n", fileName);
 }
 
 /*
@@ -207,26 +257,48 @@ writeResults (Results * res, RunParams * runprms)
 void
 checkOutputFolder (RunParams * runprms)
 {
+    Params *prms = runprms->prms;
     // check if realization folder exists
-    char realfolder[200];
-    sprintf (realfolder, "mkdir -p %s/%d", prms.output_folder, runprms->iRun);
-    int ret = system (realfolder);
+    char realfolder[256], command[300];
+    realizationFolder (realfolder, runprms);
+    sprintf (command, "mkdir -p %s", realfolder);
+    int ret = system (command);
     if (ret)
-        output (O_FORCE, "could not create output realization folder!\n");
+        output (prms, O_FORCE,
+                "could not create output realization folder!\n");
+
+}
+
+/*
+ * The folder of the realization of a run. With a job file, the runs of
+ * every configuration have their own folders in job1, job2, ... In a
+ * sweep, every point of a run has its own folder p1, p2, ...
+ */
+void
+realizationFolder (char *folder, RunParams * runprms)
+{
+    Params *prms = runprms->prms;
+    if (prms->njobs > 1)
+        sprintf (folder, "%s/job%d/%d", prms->output_folder,
+                 runprms->iJob + 1, runprms->iRun);
+    else
+        sprintf (folder, "%s/%d", prms->output_folder, runprms->iRun);
 
+    if (prms->npoints > 1)
+        sprintf (folder + strlen (folder), "/p%d", runprms->iPoint + 1);
 }
 
 void
-writeSummary (Results * res)
+writeSummary (Results * res, Params * prms)
 {
-    if (!strArgGiven (prms.output_summary))
+    if (!strArgGiven (prms->output_summary))
         return;
 
     char fileName[1024];
     FILE *file, *file2;
     int buffer = 0;
 
-    sprintf (fileName, "%s", prms.output_summary);
+    sprintf (fileName, "%s", prms->output_summary);
 
     // check for the header
     file2 = fopen (fileName, "r");
@@ -247,9 +319,9 @@ writeSummary (Results * res)
     // the mode string
     char mode[1024];
     sprintf (mode, "%s-%s-%s", 
-        prms.balance_eq ? "be" : "mc",
-        prms.many ? "many" : "meanfield",
-        prms.gaussian ? "full" : "half");
+        prms->balance_eq ? "be" : "mc",
+        prms->many ? "many" : "meanfield",
+        prms->gaussian ? "full" : "half");
     
     // write header
     if (buffer == 0)
@@ -327,19 +399,19 @@ writeSummary (Results * res)
 
     // write site information
     fprintf (file, "%-20s", mode);
-    fprintf (file, "%-+20e", prms.exponent);
-    fprintf (file, "%-20d", prms.length_x);
+    fprintf (file, "%-+20e", prms->exponent);
+    fprintf (file, "%-20d", prms->length_x);
     fprintf (file, "%-20e", res->nSites.avg);
-    fprintf (file, "%-20d", prms.ncarriers);
-    fprintf (file, "%-+20e", prms.loclength);
-    fprintf (file, "%-+20e", prms.temperature);
-    fprintf (file, "%-+20e", prms.field);
-    fprintf (file, "%-20d", prms.number_runs);
-    fprintf (file, "%-20d", prms.balance_eq ? 0 : prms.number_reruns);
-    fprintf (file, "%-20lu", prms.balance_eq ? 0 : prms.relaxation);
-    fprintf (file, "%-20lu", prms.balance_eq ? 0 : prms.simulation);
-    fprintf (file, "%-+20e", prms.cut_dos ? prms.cut_out_energy : 0);
-    fprintf (file, "%-+20e", prms.cut_dos ? prms.cut_out_width : 0);
+    fprintf (file, "%-20d", res->ncarriers);
+    fprintf (file, "%-+20e", res->loclength);
+    fprintf (file, "%-+20e", res->temperature);
+    fprintf (file, "%-+20e", res->field);
+    fprintf (file, "%-20d", prms->number_runs);
+    fprintf (file, "%-20d", prms->balance_eq ? 0 : prms->number_reruns);
+    fprintf (file, "%-20lu", prms->balance_eq ? 0 : prms->relaxation);
+    fprintf (file, "%-20lu", prms->balance_eq ? 0 : prms->simulation);
+    fprintf (file, "%-+20e", prms->cut_dos ? prms->cut_out_energy : 0);
+    fprintf (file, "%-+20e", prms->cut_dos ? prms->cut_out_width : 0);
     fprintf (file, "%-+20e", res->simulationTime.avg);
     fprintf (file, "%-+20e", res->simulationTime.err);
     fprintf (file, "%-+20e", res->mobility.avg);
@@ -354,12 +426,12 @@ writeSummary (Results * res)
     fprintf (file, "%-+20e", res->equilibrationEnergy.err);
     fprintf (file, "%-+20e", res->avgenergy.avg);
     fprintf (file, "%-+20e", res->avgenergy.err);
-    fprintf (file, "%-20lu", prms.rseed);
+    fprintf (file, "%-20lu", prms->rseed);
     fprintf (file, "%-20s", timestring_start);
     fprintf (file, "%-20s", timestring_finish);
 
-    if (strArgGiven (prms.comment))
-        fprintf (file, "%s", prms.comment);
+    if (strArgGiven (prms->comment))
+        fprintf (file, "%s", prms->comment);
     else
         fprintf (file, "-");
 
@@ -368,7 +440,7 @@ writeSummary (Results * res)
     fclose (file);
 
     // some output
-    output (O_SERIAL, "\nExtended summary file %s\n", fileName);
+    output (prms, O_SERIAL, "\nExtended summary file %s\n", fileName);
 }
 
 void get_timestring(char ** timestring, time_t t) 
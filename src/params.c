@@ -21,24 +21,30 @@
 
 #include "hop.h"
 
+int parseList (char *arg, float value, float **values);
+void readJobFile (char *fileName, Params * prms);
+
 /*
- * Initialize all the params and make some rudimentary checks.
+ * Initialize all the params and make some rudimentary checks. The parsed
+ * command line is kept in prms->cmdlineargs, see freeParams().
  */
-struct gengetopt_args_info args;
-
 void
 generateParams (Params * prms, int argc, char **argv)
 {
 
     // the gengetopt arguments
+    struct gengetopt_args_info *args;
     struct cmdline_parser_params *params;
+    memset (prms, 0, sizeof (Params));
+    args = (struct gengetopt_args_info *)
+        malloc (sizeof (struct gengetopt_args_info));
     params = cmdline_parser_params_create ();
-    prms->cmdlineargs = &args;
+    prms->cmdlineargs = args;
 
     // init command line parser and exit if anything went wrong
-    if (cmdline_parser (argc, argv, &args) != 0)
+    if (cmdline_parser (argc, argv, args) != 0)
     {
-        output (O_FORCE, "Commandline error\n");
+        output (prms, O_FORCE, "Commandline error\n");
         exit (1);
     }
 
@@ -46,22 +52,24 @@ generateParams (Params * prms, int argc, char **argv)
     prms->loctime = localtime (&prms->curtime);
     gsl_rng_env_setup ();
     prms->T = gsl_rng_gfsr4;
+    if (args->counterrng_given)
+        prms->T = RNG_philox;
     //prms->r = gsl_rng_alloc (prms->T);
 
     // random seed
     prms->rseed = 0;
-    if (args.rseed_given)
+    if (args->rseed_given)
     {
-        prms->rseed = args.rseed_arg;
+        prms->rseed = args->rseed_arg;
     }
 
     // do we have to load a config file?
     params->initialize = 0;
     params->override = 0;
-    if (args.conf_file_given &&
-        cmdline_parser_config_file (args.conf_file_arg, &args, params) != 0)
+    if (args->conf_file_given &&
+        cmdline_parser_config_file (args->conf_file_arg, args, params) != 0)
     {
-        output (O_FORCE, "Config file does not exist!\n");
+        output (prms, O_FORCE, "Config file does not exist!\n");
         exit (1);
     }
 
@@ -69,123 +77,206 @@ generateParams (Params * prms, int argc, char **argv)
     // if x,y,z are given, use these.
     // if nsites is given, assume cubic sample and use it.
     // if length is given, assume cubic sample and use it.
-    if (!(args.X_given && args.Y_given && args.Z_given))
+    if (!(args->X_given && args->Y_given && args->Z_given))
     {
-        if (args.nsites_given)
+        if (args->nsites_given)
         {
-            args.length_arg = floor (pow (args.nsites_arg, 1. / 3.));
-            args.length_given = 1;
+            args->length_arg = floor (pow (args->nsites_arg, 1. / 3.));
+            args->length_given = 1;
         }
 
-        if (args.length_given)
+        if (args->length_given)
         {
-            args.X_arg = args.length_arg;
-            args.Y_arg = args.length_arg;
-            args.Z_arg = args.length_arg;
+            args->X_arg = args->length_arg;
+            args->Y_arg = args->length_arg;
+            args->Z_arg = args->length_arg;
         }
     }
 
-    prms->length_x = args.X_arg;
-    prms->length_y = args.Y_arg;
-    prms->length_z = args.Z_arg;
+    prms->length_x = args->X_arg;
+    prms->length_y = args->Y_arg;
+    prms->length_z = args->Z_arg;
 
     prms->nsites = prms->length_x * prms->length_y * prms->length_z;
 
     // cutout stuff
     prms->cut_dos = false;
-    if (args.cutoutenergy_given)
+    if (args->cutoutenergy_given)
     {
-        prms->cut_out_energy = args.cutoutenergy_arg;
-        prms->cut_out_width = args.cutoutwidth_arg;
+        prms->cut_out_energy = args->cutoutenergy_arg;
+        prms->cut_out_width = args->cutoutwidth_arg;
         prms->cut_dos = true;
     }
 
     // check cutoff radius
-    if (0 > args.rc_arg ||
-        args.rc_arg > GSL_MIN (GSL_MIN (prms->length_y, prms->length_x),
+    if (0 > args->rc_arg ||
+        args->rc_arg > GSL_MIN (GSL_MIN (prms->length_y, prms->length_x),
                                prms->length_z))
     {
-        output (O_FORCE, "Please choose a valid cut-off radius!\n");
+        output (prms, O_FORCE, "Please choose a valid cut-off radius!\n");
         exit (1);
     }
-    prms->cutoff_radius = args.rc_arg;
+    prms->cutoff_radius = args->rc_arg;
+
+    // the unit of the displacements in the neighbor lists
+    prms->dist_unit = 1.0;
+    if (prms->cutoff_radius > 0)
+        prms->dist_unit = ldexp (1.0, (int) ceil (log2 (prms->cutoff_radius /
+                                                        SHRT_MAX)));
 
     // exponent
-    if (0 >= args.exponent_arg)
+    if (0 >= args->exponent_arg)
     {
-        output (O_FORCE, "Please choose a valid DOS exponent!\n");
+        output (prms, O_FORCE, "Please choose a valid DOS exponent!\n");
         exit (1);
     }
-    prms->exponent = args.exponent_arg;
+    prms->exponent = args->exponent_arg;
 
     // loclength
-    if (0 >= args.llength_arg || args.llength_arg > 2)
+    if (0 >= args->llength_arg || args->llength_arg > 2)
     {
-        output (O_FORCE, "Please choose a valid localization length!\n");
+        output (prms, O_FORCE, "Please choose a valid localization length!\n");
         exit (1);
     }
-    prms->loclength = args.llength_arg;
+    prms->loclength = args->llength_arg;
 
     // softpairthreshold
-    if (0 >= args.softpairthreshold_arg)
+    if (0 >= args->softpairthreshold_arg)
+    {
+        output (prms, O_FORCE, "Please choose a valid softpair threshold\n");
+        exit (1);
+    }
+    prms->softpairthreshold = args->softpairthreshold_arg;
+
+    // rate mass of the neighbors
+    if (0 >= args->ratemass_arg || args->ratemass_arg > 1)
+    {
+        output (prms, O_FORCE, "Please choose a rate mass in (0, 1]!\n");
+        exit (1);
+    }
+    prms->ratemass = args->ratemass_arg;
+
+    // clusters of --coarsegrain
+    if (0 >= args->clusterthreshold_arg || args->clusterthreshold_arg >= 1)
+    {
+        output (prms, O_FORCE,
+                "Please choose a cluster threshold in (0, 1)!\n");
+        exit (1);
+    }
+    prms->clusterthreshold = args->clusterthreshold_arg;
+    if (args->clustersize_arg < 2)
+    {
+        output (prms, O_FORCE,
+                "Please choose a cluster size of at least two sites!\n");
+        exit (1);
+    }
+    prms->clustersize = args->clustersize_arg;
+    if (args->superbasin_arg < 0)
     {
-        output (O_FORCE, "Please choose a valid softpair threshold\n");
+        output (prms, O_FORCE,
+                "Please choose a non-negative number of hops for --superbasin!\n");
         exit (1);
     }
-    prms->softpairthreshold = args.softpairthreshold_arg;
+    prms->superbasin = args->superbasin_arg;
 
     // field
-    prms->field = args.field_arg;
+    prms->field = args->field_arg;
 
     // temperature
-    if (0 > args.temperature_arg)
+    if (0 > args->temperature_arg)
     {
-        output (O_FORCE, "Please choose a valid temperature!\n");
+        output (prms, O_FORCE, "Please choose a valid temperature!\n");
         exit (1);
     }
-    prms->temperature = args.temperature_arg;
+    prms->temperature = args->temperature_arg;
+
+    // the points of the sweep, all combinations of the temperatures and
+    // fields
+    float *temperatures, *fields;
+    int nTemperatures, nFields, i;
+
+    nTemperatures = parseList (args->temperatures_arg, prms->temperature,
+                               &temperatures);
+    nFields = parseList (args->fields_arg, prms->field, &fields);
+    if (nFields < 1)
+    {
+        output (prms, O_FORCE, "Please choose valid fields!\n");
+        exit (1);
+    }
+    for (i = 0; i < nTemperatures; ++i)
+        if (0 > temperatures[i])
+            nTemperatures = 0;
+    if (nTemperatures < 1)
+    {
+        output (prms, O_FORCE, "Please choose valid temperatures!\n");
+        exit (1);
+    }
+
+    prms->npoints = nTemperatures * nFields;
+    prms->temperatures = (float *) malloc (sizeof (float) * prms->npoints);
+    prms->fields = (float *) malloc (sizeof (float) * prms->npoints);
+    for (i = 0; i < prms->npoints; ++i)
+    {
+        prms->temperatures[i] = temperatures[i / nFields];
+        prms->fields[i] = fields[i % nFields];
+    }
+    prms->temperature = prms->temperatures[0];
+    prms->field = prms->fields[0];
+    free (temperatures);
+    free (fields);
 
     // flags
-    prms->gaussian = (args.gaussian_given) ? true : false;
-    prms->lattice = (args.lattice_given) ? true : false;
-    prms->removesoftpairs = (args.removesoftpairs_given) ? true : false;
-    prms->parallel = (args.parallel_given) ? true : false;
-    prms->quiet = (args.quiet_given) ? true : false;
-    prms->output_transitions = (args.transitions_given) ? true : false;
-    prms->memreq = (args.memreq_given) ? true : false;
-    prms->balance_eq = (args.be_given) ? true : false;
-    prms->mgmres = (args.mgmres_given) ? true : false;
-    prms->many = (args.many_given) ? true : false;
+    prms->gaussian = (args->gaussian_given) ? true : false;
+    prms->implicitlattice = (args->implicitlattice_given) ? true : false;
+    prms->lattice = (args->lattice_given || prms->implicitlattice) ? true : false;
+    prms->reorder = (args->reorder_given) ? true : false;
+    prms->removesoftpairs = (args->removesoftpairs_given) ? true : false;
+    prms->coarsegrain = (args->coarsegrain_given) ? true : false;
+    prms->parallel = (args->parallel_given) ? true : false;
+    prms->quiet = (args->quiet_given) ? true : false;
+    prms->output_transitions = (args->transitions_given) ? true : false;
+    prms->memreq = (args->memreq_given) ? true : false;
+    prms->balance_eq = (args->be_given) ? true : false;
+    prms->mgmres = (args->mgmres_given) ? true : false;
+    prms->many = (args->many_given) ? true : false;
+    prms->alias = (args->alias_given) ? true : false;
+    prms->calendar = (args->calendar_given) ? true : false;
+    prms->rejectionfree = (args->rejectionfree_given) ? true : false;
+    prms->kernelbench = (args->kernelbench_given) ? true : false;
+    prms->fastrng = (args->fastrng_given) ? true : false;
+    prms->counterrng = (args->counterrng_given) ? true : false;
+    prms->parallelreruns = (args->parallelreruns_given) ? true : false;
+    prms->redrawenergies = (args->redrawenergies_given) ? true : false;
     prms->lis = false;
 
 #ifndef WITH_LIS
 
-    prms.mgmres = true;
+    prms->mgmres = true;
 
 #endif
 
 
     // balance equation parameters
-    if (args.be_it_arg == 0)
-        args.be_it_arg = prms->nsites - 1;
-    prms->be_abs_tol = args.tol_abs_arg;
-    prms->be_rel_tol = args.tol_rel_arg;
-    prms->be_it = args.be_it_arg;
-    prms->be_outer_it = args.be_oit_arg;
+    if (args->be_it_arg == 0)
+        args->be_it_arg = prms->nsites - 1;
+    prms->be_abs_tol = args->tol_abs_arg;
+    prms->be_rel_tol = args->tol_rel_arg;
+    prms->be_it = args->be_it_arg;
+    prms->be_outer_it = args->be_oit_arg;
 
     // strings
-    prms->output_folder = args.outputfolder_arg;
-    prms->output_summary = args.summary_arg;
-    prms->comment = args.comment_arg;
+    prms->output_folder = args->outputfolder_arg;
+    prms->output_summary = args->summary_arg;
+    prms->comment = args->comment_arg;
 
     // simulation times
-    if (0 > args.relaxation_arg || 0 > args.simulation_arg)
+    if (0 > args->relaxation_arg || 0 > args->simulation_arg)
     {
-        output (O_FORCE, "Please choose valid simulation times\n");
+        output (prms, O_FORCE, "Please choose valid simulation times\n");
         exit (1);
     }
-    prms->relaxation = args.relaxation_arg;
-    prms->simulation = args.simulation_arg;
+    prms->relaxation = args->relaxation_arg;
+    prms->simulation = args->simulation_arg;
 
     // calculate number of cells
     prms->nx = ceil (prms->length_x / prms->cutoff_radius);
@@ -193,36 +284,155 @@ generateParams (Params * prms, int argc, char **argv)
     prms->nz = ceil (prms->length_z / prms->cutoff_radius);
 
     // check charge carriers
-    if (args.ncarriers_arg >= prms->nsites)
+    if (args->ncarriers_arg >= prms->nsites)
     {
-        output (O_FORCE, "Your system is overfilled with carriers.\n");
+        output (prms, O_FORCE, "Your system is overfilled with carriers.\n");
         exit (1);
     }
-    prms->ncarriers = args.ncarriers_arg;
+    prms->ncarriers = args->ncarriers_arg;
+
+    // the configurations of the job file. They replace the sweep, which
+    // would need a result per configuration and point.
+    if (strArgGiven (args->jobfile_arg))
+    {
+        if (prms->npoints > 1)
+        {
+            output (prms, O_FORCE,
+                    "--jobfile does not work with --temperatures or --fields!\n");
+            exit (1);
+        }
+        readJobFile (args->jobfile_arg, prms);
+    }
+    else
+    {
+        prms->njobs = 1;
+        prms->jobs = (Job *) malloc (sizeof (Job));
+        prms->jobs[0].temperature = prms->temperature;
+        prms->jobs[0].field = prms->field;
+        prms->jobs[0].loclength = prms->loclength;
+        prms->jobs[0].ncarriers = prms->ncarriers;
+    }
+
+    // the mode is the same for all configurations, so that of the one
+    // with the most carriers counts
+    int maxCarriers = 1;
+    for (i = 0; i < prms->njobs; ++i)
+        maxCarriers = GSL_MAX (maxCarriers, prms->jobs[i].ncarriers);
 
     // be must use the meanfield approach for multiple charge carriers
-    if (prms->balance_eq && prms->ncarriers > 1)
+    if (prms->balance_eq && maxCarriers > 1)
         prms->many = false;
 
+    // without other carriers, no attempt can fail
+    if (!prms->many)
+        prms->rejectionfree = false;
+
+    // the walkers of parallel reruns are independent meanfield carriers
+    if (args->interleave_arg < 1)
+    {
+        output (prms, O_FORCE,
+                "Please choose a positive number of interleaved walkers\n");
+        exit (1);
+    }
+    prms->interleave = args->interleave_arg;
+    if (prms->interleave > 1)
+        prms->parallelreruns = true;
+    if (prms->many)
+        prms->parallelreruns = false;
+
+    // the clusters are passed by a single carrier in the generic hopping
+    // step
+    if ((prms->coarsegrain || prms->superbasin > 0) &&
+        (prms->many || prms->balance_eq || prms->implicitlattice ||
+         prms->parallelreruns))
+    {
+        output (prms, O_FORCE,
+                "--coarsegrain and --superbasin do not work with --many, --be, --implicitlattice or --parallelreruns!\n");
+        exit (1);
+    }
+
+    // the following points of a sweep reuse the neighbor graph. The
+    // truncated one and the sites of the meanfield approach with several
+    // carriers depend on the temperature, the cut-out ones on the
+    // energies.
+    if (prms->npoints > 1 &&
+        (prms->ratemass < 1 || (prms->ncarriers > 1 && !prms->many) ||
+         (prms->cut_dos && prms->redrawenergies)))
+    {
+        output (prms, O_FORCE,
+                "Sweeps do not work with --ratemass, -n without --many, or --cutoutenergy with --redrawenergies!\n");
+        exit (1);
+    }
+
+    // the implicit lattice has no neighbor graph and keeps all sites in
+    // the lattice order. Different offsets of its stencil must not lead
+    // to the same site. The alias tables and the rejection-free mode need
+    // the neighbor lists, it always uses the plain hopping loop.
+    if (prms->implicitlattice)
+    {
+        if (prms->balance_eq || prms->cut_dos || prms->removesoftpairs ||
+            prms->output_transitions || prms->ratemass < 1 ||
+            (maxCarriers > 1 && !prms->many))
+        {
+            output (prms, O_FORCE,
+                    "--implicitlattice does not work with --be, --cutoutenergy, --removesoftpairs, --transitions, --ratemass or -n without --many!\n");
+            exit (1);
+        }
+
+        if (2 * prms->cutoff_radius >
+            GSL_MIN (GSL_MIN (prms->length_x, prms->length_y),
+                     prms->length_z))
+        {
+            output (prms, O_FORCE,
+                    "Please choose a cut-off radius of at most half the sample size for --implicitlattice!\n");
+            exit (1);
+        }
+
+        prms->alias = false;
+        prms->rejectionfree = false;
+        prms->reorder = false;
+    }
+
     // number of runs
-    if (args.nruns_arg < 1)
-        args.nruns_arg = 1;
-    prms->number_runs = args.nruns_arg;
+    if (args->nruns_arg < 1)
+        args->nruns_arg = 1;
+    prms->number_runs = args->nruns_arg;
 
     // number of reruns (starting pos of the electron)
-    if (args.nreruns_arg < 1)
-        args.nreruns_arg = 1;
-    prms->number_reruns = args.nreruns_arg;
+    if (args->nreruns_arg < 1)
+        args->nreruns_arg = 1;
+    prms->number_reruns = args->nreruns_arg;
+
+    // the reruns and points of a sweep are part of the address of the
+    // counter-based streams
+    if (prms->counterrng &&
+        (long) prms->npoints * prms->number_reruns >= RNG_MAX_RERUN)
+    {
+        output (prms, O_FORCE,
+                "--counterrng supports fewer than %d reruns times points!\n",
+                RNG_MAX_RERUN);
+        exit (1);
+    }
 
-    // threads
-    if (args.nthreads_arg == 0 || args.nthreads_arg > omp_get_max_threads ())
-        prms->nthreads = (GSL_MIN (omp_get_max_threads (), prms->number_runs));
+    // the visits of a site are counted in 32 bit
+    if ((double) prms->number_reruns * prms->simulation > UINT_MAX &&
+        strArgGiven (prms->output_folder))
+        output (prms, O_FORCE,
+                "The visit counters of the sites may overflow in sites.dat\n");
+
+    // threads. With --parallel, the runs are distributed over them, with
+    // parallel reruns the reruns. The setup of a single run always uses
+    // all of them.
+    if (args->nthreads_arg == 0 || args->nthreads_arg > omp_get_max_threads ())
+        prms->nthreads = omp_get_max_threads ();
     else
-        prms->nthreads = (GSL_MIN (args.nthreads_arg, prms->number_runs));
+        prms->nthreads = args->nthreads_arg;
 
 
-    // if prms.nthreads == 1 for any reason, disable parallel computing
-    if (prms->nthreads == 1)
+    // if there is only one thread or run for any reason, disable parallel
+    // computing. With a job file, the runs of all configurations are
+    // distributed.
+    if (prms->nthreads == 1 || prms->njobs * prms->number_runs == 1)
         prms->parallel = false;
 
 
@@ -231,6 +441,19 @@ generateParams (Params * prms, int argc, char **argv)
 
 }
 
+/*
+ * Frees the memory of the parameters, see generateParams().
+ */
+void
+freeParams (Params * prms)
+{
+    cmdline_parser_free (prms->cmdlineargs);
+    free (prms->cmdlineargs);
+    free (prms->temperatures);
+    free (prms->fields);
+    free (prms->jobs);
+}
+
 /*
  * Is a string argument given?
  */
@@ -239,3 +462,143 @@ strArgGiven (char *arg)
 {
     return (arg != NULL);
 }
+
+/*
+ * Parses the comma-separated list arg into a new array *values and
+ * returns its length, or 0 if it is invalid. Without a list, it is the
+ * single value.
+ */
+int
+parseList (char *arg, float value, float **values)
+{
+    int n = 1;
+    char *c, *end;
+
+    if (!strArgGiven (arg))
+    {
+        *values = (float *) malloc (sizeof (float));
+        (*values)[0] = value;
+        return 1;
+    }
+
+    for (c = arg; *c != '\0'; ++c)
+        if (*c == ',')
+            n++;
+    *values = (float *) malloc (sizeof (float) * n);
+
+    for (n = 0, c = arg;; c = end + 1)
+    {
+        (*values)[n++] = strtof (c, &end);
+        if (end == c || (*end != ',' && *end != '\0'))
+            return 0;
+        if (*end == '\0')
+            return n;
+    }
+}
+
+/*
+ * Reads the configurations of the job file into prms->jobs. Every line is
+ * one configuration, which sets any of the options -T, -F, -a and -n like
+ * on the command line, e.g. "-T 0.3 --field=0.05 -n 10". The others keep
+ * their values from the command line. Empty lines and lines starting with
+ * # are skipped.
+ */
+void
+readJobFile (char *fileName, Params * prms)
+{
+    FILE *file;
+    char line[1024], letter[2] = "", *word, *name, *value, *end;
+    int lineNumber = 0, size = 16;
+    bool valid;
+    float number;
+    Job *job;
+
+    file = fopen (fileName, "r");
+    if (file == NULL)
+    {
+        output (prms, O_FORCE, "Could not open the job file %s!\n", fileName);
+        exit (1);
+    }
+
+    prms->njobs = 0;
+    prms->jobs = (Job *) malloc (sizeof (Job) * size);
+    while (fgets (line, sizeof (line), file) != NULL)
+    {
+        lineNumber++;
+        word = strtok (line, " \t\r\n");
+        if (word == NULL || word[0] == '#')
+            continue;
+
+        if (prms->njobs == size)
+        {
+            size *= 2;
+            prms->jobs = (Job *) realloc (prms->jobs, sizeof (Job) * size);
+        }
+        job = &prms->jobs[prms->njobs++];
+        job->temperature = prms->temperature;
+        job->field = prms->field;
+        job->loclength = prms->loclength;
+        job->ncarriers = prms->ncarriers;
+
+        for (; word != NULL; word = strtok (NULL, " \t\r\n"))
+        {
+            // the value follows the option after a '=', directly after a
+            // short option, or as the next word
+            value = NULL;
+            name = "";
+            if (strncmp (word, "--", 2) == 0)
+            {
+                name = word + 2;
+                value = strchr (name, '=');
+                if (value != NULL)
+                    *value++ = '\0';
+            }
+            else if (word[0] == '-' && word[1] != '\0')
+            {
+                letter[0] = word[1];
+                name = letter;
+                if (word[2] != '\0')
+                    value = word + 2;
+            }
+            if (value == NULL)
+                value = strtok (NULL, " \t\r\n");
+
+            valid = false;
+            if (value != NULL)
+            {
+                number = strtof (value, &end);
+                valid = (end != value && *end == '\0');
+            }
+
+            if (valid && (strcmp (name, "T") == 0 ||
+                          strcmp (name, "temperature") == 0) && number >= 0)
+                job->temperature = number;
+            else if (valid && (strcmp (name, "F") == 0 ||
+                               strcmp (name, "field") == 0))
+                job->field = number;
+            else if (valid && (strcmp (name, "a") == 0 ||
+                               strcmp (name, "llength") == 0) &&
+                     number > 0 && number <= 2)
+                job->loclength = number;
+            else if (valid && (strcmp (name, "n") == 0 ||
+                               strcmp (name, "ncarriers") == 0) &&
+                     number >= 1 && number < prms->nsites &&
+                     number == (int) number)
+                job->ncarriers = (int) number;
+            else
+            {
+                output (prms, O_FORCE,
+                        "Invalid configuration in line %d of the job file!\n",
+                        lineNumber);
+                exit (1);
+            }
+        }
+    }
+    fclose (file);
+
+    if (prms->njobs == 0)
+    {
+        output (prms, O_FORCE, "The job file contains no configurations!\n");
+        exit (1);
+    }
+}
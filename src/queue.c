@@ -0,0 +1,336 @@
+/*
+ * hophop: Charge transport simulations in disordered systems
+ *
+ * Copyright (c) 2012-2018 Jan Oliver Oelerich <jan.oliver.oelerich@physik.uni-marburg.de>
+ * Copyright (c) 2012-2018 Disordered Many-Particle Physics Group, Philipps-Universität Marburg, Germany
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+*/
+
+
+#include "hop.h"
+
+// the heap is shifted by this many elements, so that the four children
+// of every node share one cache line of 64 bytes.
+#define HEAP_OFFSET 3
+
+void heapSiftUp (EventQueue * q, int i);
+void heapSiftDown (EventQueue * q, int i);
+void calendarCalibrate (EventQueue * q);
+void calendarInsert (EventQueue * q, int c);
+void calendarRemove (EventQueue * q, int c);
+int calendarBucket (EventQueue * q, double time);
+int compare_doubles (const void *a, const void *b);
+
+/*
+ * Allocates an event queue for n carriers. The carriers themselves are
+ * never moved, the queue only stores (time, carrier index) pairs. type is
+ * either Q_HEAP for a 4-ary heap or Q_CALENDAR for a calendar queue.
+ */
+EventQueue *
+EQ_create (int n, int type)
+{
+    EventQueue *q = (EventQueue *) malloc (sizeof (EventQueue));
+
+    q->type = type;
+    q->n = n;
+    q->pos = (int *) malloc (sizeof (int) * n);
+    q->time = (double *) malloc (sizeof (double) * n);
+    q->heapMemory = NULL;
+    q->heap = NULL;
+    q->next = NULL;
+    q->bucketHead = NULL;
+    q->nBuckets = 0;
+
+    if (type == Q_HEAP)
+    {
+        // align the heap memory to 64 bytes
+        q->heapMemory = malloc (sizeof (Event) * (n + HEAP_OFFSET) + 64);
+        q->heap = (Event *) (((size_t) q->heapMemory + 63) & ~(size_t) 63);
+        q->heap += HEAP_OFFSET;
+    }
+    else
+    {
+        // one bucket per carrier, rounded up to a power of two
+        q->nBuckets = 1;
+        while (q->nBuckets < n)
+            q->nBuckets *= 2;
+
+        q->next = (int *) malloc (sizeof (int) * n);
+        q->bucketHead = (int *) malloc (sizeof (int) * q->nBuckets);
+    }
+
+    return q;
+}
+
+void
+EQ_free (EventQueue * q)
+{
+    if (q == NULL)
+        return;
+
+    free (q->pos);
+    free (q->time);
+    free (q->heapMemory);
+    free (q->next);
+    free (q->bucketHead);
+    free (q);
+}
+
+/*
+ * (Re)builds the queue from the occupation times of the carriers. This has
+ * to be called whenever the times of all carriers are changed at once.
+ */
+void
+EQ_build (EventQueue * q, Carrier * carriers)
+{
+    int i;
+
+    for (i = 0; i < q->n; ++i)
+        q->time[i] = carriers[i].occTime;
+
+    if (q->type == Q_HEAP)
+    {
+        for (i = 0; i < q->n; ++i)
+        {
+            q->heap[i].time = q->time[i];
+            q->heap[i].carrier = i;
+            q->pos[i] = i;
+        }
+
+        // heapify bottom-up
+        for (i = (q->n - 2) / 4; i >= 0; --i)
+            heapSiftDown (q, i);
+    }
+    else
+    {
+        calendarCalibrate (q);
+    }
+}
+
+/*
+ * Returns the index of the carrier with the smallest occupation time.
+ */
+int
+EQ_top (EventQueue * q)
+{
+    int i, b, best;
+
+    if (q->type == Q_HEAP)
+        return q->heap[0].carrier;
+
+    // calendar queue: search the buckets of the current "year"
+    for (i = 0; i < q->nBuckets; ++i)
+    {
+        b = q->current;
+        if (q->bucketHead[b] >= 0 &&
+            q->time[q->bucketHead[b]] < q->bucketTop)
+            return q->bucketHead[b];
+
+        q->current = (q->current + 1) & (q->nBuckets - 1);
+        q->bucketTop += q->width;
+    }
+
+    // nothing found within one year, search directly for the minimum and
+    // continue from there
+    best = -1;
+    for (b = 0; b < q->nBuckets; ++b)
+        if (q->bucketHead[b] >= 0 &&
+            (best < 0 || q->time[q->bucketHead[b]] < q->time[best]))
+            best = q->bucketHead[b];
+
+    q->current = q->pos[best];
+    q->bucketTop = (floor (q->time[best] / q->width) + 1) * q->width;
+
+    return best;
+}
+
+/*
+ * Assigns a new occupation time to the carrier c and restores the order of
+ * the queue.
+ */
+void
+EQ_update (EventQueue * q, int c, double time)
+{
+    double old = q->time[c];
+
+    q->time[c] = time;
+
+    if (q->type == Q_HEAP)
+    {
+        q->heap[q->pos[c]].time = time;
+        if (time < old)
+            heapSiftUp (q, q->pos[c]);
+        else
+            heapSiftDown (q, q->pos[c]);
+    }
+    else
+    {
+        calendarRemove (q, c);
+        calendarInsert (q, c);
+
+        // recalibrate the bucket width every n updates, the distribution
+        // of event times drifts during the simulation
+        if (++q->nUpdates >= q->n)
+            calendarCalibrate (q);
+    }
+}
+
+/*
+ * Moves the element at position i up the 4-ary heap. The children of node
+ * i are at 4i+1 ... 4i+4.
+ */
+void
+heapSiftUp (EventQueue * q, int i)
+{
+    int parent;
+    Event e = q->heap[i];
+
+    while (i > 0)
+    {
+        parent = (i - 1) / 4;
+        if (q->heap[parent].time <= e.time)
+            break;
+
+        q->heap[i] = q->heap[parent];
+        q->pos[q->heap[i].carrier] = i;
+        i = parent;
+    }
+
+    q->heap[i] = e;
+    q->pos[e.carrier] = i;
+}
+
+void
+heapSiftDown (EventQueue * q, int i)
+{
+    int child, smallest, last;
+    Event e = q->heap[i];
+
+    while (1)
+    {
+        child = 4 * i + 1;
+        if (child >= q->n)
+            break;
+
+        // find the smallest of the (up to) four children
+        smallest = child;
+        last = GSL_MIN (child + 4, q->n);
+        for (++child; child < last; ++child)
+            if (q->heap[child].time < q->heap[smallest].time)
+                smallest = child;
+
+        if (q->heap[smallest].time >= e.time)
+            break;
+
+        q->heap[i] = q->heap[smallest];
+        q->pos[q->heap[i].carrier] = i;
+        i = smallest;
+    }
+
+    q->heap[i] = e;
+    q->pos[e.carrier] = i;
+}
+
+/*
+ * Chooses the bucket width of the calendar queue from the spacing of the
+ * earliest events and redistributes all carriers into the buckets.
+ */
+void
+calendarCalibrate (EventQueue * q)
+{
+    int i, k, nFinite;
+    double *sorted = (double *) malloc (sizeof (double) * q->n);
+
+    memcpy (sorted, q->time, sizeof (double) * q->n);
+    qsort (sorted, q->n, sizeof (double), compare_doubles);
+
+    // carriers that cannot hop have infinite times and are sorted last
+    for (nFinite = q->n; nFinite > 0 && isinf (sorted[nFinite - 1]);
+         --nFinite);
+
+    // the average separation of the events that are due next. Carriers in
+    // deep traps have very large times and are ignored this way.
+    k = GSL_MAX (1, GSL_MIN (nFinite - 1, nFinite / 10));
+    q->width = (nFinite > 1) ? 3.0 * (sorted[k] - sorted[0]) / k : 0.0;
+    if (!(q->width > 0))
+        q->width = 1.0;
+    if (nFinite == 0)
+        sorted[0] = 0.0;
+
+    for (i = 0; i < q->nBuckets; ++i)
+        q->bucketHead[i] = -1;
+    for (i = 0; i < q->n; ++i)
+        calendarInsert (q, i);
+
+    q->current = ((long) (sorted[0] / q->width)) & (q->nBuckets - 1);
+    q->bucketTop = (floor (sorted[0] / q->width) + 1) * q->width;
+    q->nUpdates = 0;
+
+    free (sorted);
+}
+
+/*
+ * Inserts carrier c into its bucket, which is kept sorted by time.
+ */
+void
+calendarInsert (EventQueue * q, int c)
+{
+    int b, *link;
+
+    b = calendarBucket (q, q->time[c]);
+    q->pos[c] = b;
+
+    link = &q->bucketHead[b];
+    while (*link >= 0 && q->time[*link] < q->time[c])
+        link = &q->next[*link];
+
+    q->next[c] = *link;
+    *link = c;
+}
+
+void
+calendarRemove (EventQueue * q, int c)
+{
+    int *link = &q->bucketHead[q->pos[c]];
+
+    while (*link != c)
+        link = &q->next[*link];
+
+    *link = q->next[c];
+}
+
+/*
+ * Returns the bucket of an event time. Infinite times, i.e., carriers
+ * that cannot hop, go to the last bucket.
+ */
+int
+calendarBucket (EventQueue * q, double time)
+{
+    if (isinf (time))
+        return q->nBuckets - 1;
+
+    return ((long) (time / q->width)) & (q->nBuckets - 1);
+}
+
+/*
+ * Compare two doubles, ascending
+ */
+int
+compare_doubles (const void *a, const void *b)
+{
+    double diff = *((double *) a) - *((double *) b);
+    return diff < 0 ? -1 : (diff > 0) ? 1 : 0;
+}
@@ -0,0 +1,270 @@
+/*
+ * hophop: Charge transport simulations in disordered systems
+ *
+ * Copyright (c) 2012-2018 Jan Oliver Oelerich <jan.oliver.oelerich@physik.uni-marburg.de>
+ * Copyright (c) 2012-2018 Disordered Many-Particle Physics Group, Philipps-Universität Marburg, Germany
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+*/
+
+
+#include "hop.h"
+
+// the constants of the Philox4x32 generator
+#define PHILOX_M0 0xD2511F53U
+#define PHILOX_M1 0xCD9E8D57U
+#define PHILOX_W0 0x9E3779B9U
+#define PHILOX_W1 0xBB67AE85U
+
+// the state of a Philox4x32-10 stream. The counter consists of the
+// position within the stream and the stream address: counter[0] holds the
+// low 32 bits of the position, counter[1] the stream, counter[2] the
+// rerun in its low and the high 16 bits of the position in its high 16
+// bits, and counter[3] the run. A stream thus has 2^48 blocks of four
+// numbers.
+typedef struct philox_state
+{
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t out[4];
+    int iOut;
+} PhiloxState;
+
+static inline uint64_t rotl (uint64_t x, int k);
+uint64_t splitmix64 (uint64_t * x);
+void nextBlock (RNGBuffer * b, double *dest, bool exponential);
+void philoxSet (void *state, unsigned long int seed);
+unsigned long int philoxGet (void *state);
+double philoxGetDouble (void *state);
+
+// the Philox generator as a GSL generator type, so that it can be used
+// with all the gsl_ran_* functions
+static const gsl_rng_type philoxType = {
+    "philox4x32-10",
+    0xffffffffUL,
+    0,
+    sizeof (PhiloxState),
+    &philoxSet,
+    &philoxGet,
+    &philoxGetDouble
+};
+
+const gsl_rng_type *RNG_philox = &philoxType;
+
+/*
+ * Allocates the random number buffer of a run. The RNG_LANES independent
+ * xoshiro256++ generators are seeded from the GSL generator r, so that
+ * the --rseed option keeps working.
+ */
+RNGBuffer *
+RNG_create (gsl_rng * r)
+{
+    RNGBuffer *b = (RNGBuffer *) malloc (sizeof (RNGBuffer));
+
+    RNG_seed (b, r);
+
+    return b;
+}
+
+/*
+ * (Re)seeds the generators of the buffer from r and discards the buffered
+ * numbers.
+ */
+void
+RNG_seed (RNGBuffer * b, gsl_rng * r)
+{
+    int i, k;
+    uint64_t seed, high, low;
+
+    // the state must not be all zero, so the seeds are scrambled with
+    // splitmix64 as recommended by the authors of xoshiro. The two draws
+    // are separate statements, so their order is fixed.
+    for (i = 0; i < RNG_LANES; ++i)
+    {
+        high = gsl_rng_get (r);
+        low = gsl_rng_get (r);
+        seed = (high << 32) ^ low;
+        for (k = 0; k < 4; ++k)
+            b->state[k][i] = splitmix64 (&seed);
+    }
+
+    b->iUniform = RNG_BLOCK;
+    b->iExponential = RNG_BLOCK;
+}
+
+void
+RNG_free (RNGBuffer * b)
+{
+    free (b);
+}
+
+void
+RNG_refillUniform (RNGBuffer * b)
+{
+    nextBlock (b, b->uniform, false);
+    b->iUniform = 0;
+}
+
+void
+RNG_refillExponential (RNGBuffer * b)
+{
+    nextBlock (b, b->exponential, true);
+    b->iExponential = 0;
+}
+
+/*
+ * Fills dest with RNG_BLOCK uniform numbers in [0,1) or exponentially
+ * distributed numbers with mean one. The lanes are independent, so both
+ * loops are vectorized, including the logarithm.
+ */
+void
+nextBlock (RNGBuffer * b, double *dest, bool exponential)
+{
+    int i, l;
+    uint64_t *s0 = b->state[0], *s1 = b->state[1];
+    uint64_t *s2 = b->state[2], *s3 = b->state[3];
+
+    // the upper 53 bits make a double in [0,1). For the exponential,
+    // (0,1] is needed to avoid log(0).
+    uint64_t shift = exponential ? 1 : 0;
+
+    for (i = 0; i < RNG_BLOCK; i += RNG_LANES)
+    {
+#pragma omp simd
+        for (l = 0; l < RNG_LANES; ++l)
+        {
+            // xoshiro256++
+            uint64_t result = rotl (s0[l] + s3[l], 23) + s0[l];
+            uint64_t t = s1[l] << 17;
+
+            s2[l] ^= s0[l];
+            s3[l] ^= s1[l];
+            s1[l] ^= s2[l];
+            s0[l] ^= s3[l];
+            s2[l] ^= t;
+            s3[l] = rotl (s3[l], 45);
+
+            dest[i + l] = ((result >> 11) + shift) * 0x1.0p-53;
+        }
+    }
+
+    if (exponential)
+    {
+#pragma omp simd
+        for (i = 0; i < RNG_BLOCK; ++i)
+            dest[i] = -log (dest[i]);
+    }
+}
+
+/*
+ * Points the Philox generator r to the beginning of the stream with the
+ * given address. Every (seed, run, rerun, stream) tuple gives an
+ * independent sequence, so work can be distributed over threads without
+ * changing the results. rerun must be below RNG_MAX_RERUN.
+ */
+void
+RNG_setStream (gsl_rng * r, unsigned long seed, int run, int rerun,
+               int stream)
+{
+    PhiloxState *p = (PhiloxState *) r->state;
+
+    p->key[0] = (uint32_t) seed;
+    p->key[1] = (uint32_t) ((uint64_t) seed >> 32);
+    p->counter[0] = 0;
+    p->counter[1] = (uint32_t) stream;
+    p->counter[2] = (uint32_t) rerun;
+    p->counter[3] = (uint32_t) run;
+    p->iOut = 4;
+}
+
+void
+philoxSet (void *state, unsigned long int seed)
+{
+    PhiloxState *p = (PhiloxState *) state;
+
+    p->key[0] = (uint32_t) seed;
+    p->key[1] = (uint32_t) ((uint64_t) seed >> 32);
+    memset (p->counter, 0, sizeof (p->counter));
+    p->iOut = 4;
+}
+
+/*
+ * Returns the next 32 bits of the stream. Each evaluation of the ten
+ * Philox rounds yields four of them.
+ */
+unsigned long int
+philoxGet (void *state)
+{
+    int i;
+    uint64_t prod0, prod1;
+    uint32_t c[4], k[2];
+    PhiloxState *p = (PhiloxState *) state;
+
+    if (p->iOut < 4)
+        return p->out[p->iOut++];
+
+    memcpy (c, p->counter, sizeof (c));
+    memcpy (k, p->key, sizeof (k));
+
+    for (i = 0; i < 10; ++i)
+    {
+        prod0 = (uint64_t) PHILOX_M0 * c[0];
+        prod1 = (uint64_t) PHILOX_M1 * c[2];
+
+        c[0] = (uint32_t) (prod1 >> 32) ^ c[1] ^ k[0];
+        c[1] = (uint32_t) prod1;
+        c[2] = (uint32_t) (prod0 >> 32) ^ c[3] ^ k[1];
+        c[3] = (uint32_t) prod0;
+
+        k[0] += PHILOX_W0;
+        k[1] += PHILOX_W1;
+    }
+
+    memcpy (p->out, c, sizeof (c));
+    p->iOut = 1;
+
+    // the position carries into the high bits of counter[2]. A stream
+    // that is used up fails rather than repeating itself.
+    if (++p->counter[0] == 0)
+    {
+        if (p->counter[2] >> 16 == 0xFFFFU)
+            gsl_error ("Philox stream exhausted after 2^48 blocks",
+                       __FILE__, __LINE__, GSL_EFAILED);
+        p->counter[2] += 1U << 16;
+    }
+
+    return p->out[0];
+}
+
+double
+philoxGetDouble (void *state)
+{
+    return philoxGet (state) / 4294967296.0;
+}
+
+static inline uint64_t
+rotl (uint64_t x, int k)
+{
+    return (x << k) | (x >> (64 - k));
+}
+
+uint64_t
+splitmix64 (uint64_t * x)
+{
+    uint64_t z = (*x += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}